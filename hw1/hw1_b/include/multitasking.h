@@ -75,7 +75,10 @@ namespace myos
         bool waitingEnter = false;
         bool checkPriority = false;
         common::size_t clockCounter = 0;
-        PriorityQueue taskQueue;
+        PriorityQueue taskQueue; // READY tasks by ID, keyed by Key()
+        CPUState *idleState = 0; // context that runs when no task is ready
+        int Key(Task *task);
+        void WakeWaiters(int pid);
 
     public:
         TaskManager();
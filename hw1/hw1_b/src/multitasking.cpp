@@ -62,36 +62,44 @@ Task::~Task()
 }
 
 /**
- * Finds the next task to be executed in the task manager.
- * The task is selected based on its state and waiting process.
- * If a task is in the READY state, it is selected as the next task.
- * If a task is in the BLOCKED state and the process it is waiting for has exited,
- * it is also selected as the next task.
- * The selected task is marked as RUNNING.
+ * Returns the key a READY task is queued with.
+ * Without priorities every task has the same key, so the queue degrades to round-robin.
  */
-void myos::TaskManager::FindNextTask()
+int myos::TaskManager::Key(Task *task)
 {
-    if (checkPriority)
+    return checkPriority ? task->priority : 0;
+}
+
+/**
+ * Makes every task that is blocked on the given process READY again.
+ * This is only done once per exiting task instead of on every clock tick.
+ *
+ * @param pid The ID of the exited task.
+ */
+void myos::TaskManager::WakeWaiters(int pid)
+{
+    for (int i = 0; i < numTasks; i++)
     {
-        if (taskQueue.isEmpty())
+        if (tasks[i]->state == TaskState::BLOCKED && tasks[i]->waitingPid == pid)
         {
-            return;
+            tasks[i]->state = TaskState::READY;
+            taskQueue.enqueue(i, Key(tasks[i]));
         }
-        currentTask = taskQueue.peek();
     }
-    while (true)
-    {
-        if (++currentTask >= numTasks)
-            currentTask %= numTasks;
-
-        if (tasks[currentTask]->state == TaskState::READY)
-            break;
+}
 
-        if (tasks[currentTask]->state == TaskState::BLOCKED &&
-            tasks[tasks[currentTask]->waitingPid]->state == TaskState::EXITED)
-            break;
-    }
-    tasks[currentTask]->state = TaskState::RUNNING;
+/**
+ * Finds the next task to be executed in the task manager.
+ * The READY task with the highest priority is taken from the task queue,
+ * tasks of equal priority are served in the order they became READY.
+ * The selected task is marked as RUNNING.
+ * If no task is ready, currentTask is set to -1 and the idle context runs instead.
+ */
+void myos::TaskManager::FindNextTask()
+{
+    currentTask = taskQueue.dequeue();
+    if (currentTask >= 0)
+        tasks[currentTask]->state = TaskState::RUNNING;
 }
 
 TaskManager::TaskManager()
@@ -116,7 +124,8 @@ bool myos::TaskManager::AddTask(Task *task)
         return false;
     tasks[numTasks++] = task;
     tasks[numTasks - 1]->id = numTasks - 1;
-    taskQueue.enqueue(numTasks - 1, task->priority);
+    if (task->state == TaskState::READY)
+        taskQueue.enqueue(task->id, Key(task));
     return true;
 }
 
@@ -125,6 +134,7 @@ void printfHex32(uint32_t);
 
 /**
  * @brief This function is responsible for scheduling tasks in a multitasking system.
+ * If no task is ready, the context interrupted before the first task switch (kernelMain) is resumed.
  *
  * @param cpustate A pointer to the CPU state.
  * @return CPUState* A pointer to the CPU state of the next scheduled task.
@@ -143,40 +153,41 @@ CPUState *TaskManager::Schedule(CPUState *cpustate)
 
     if (currentTask >= 0)
     {
-        // printf("Old Task PID: ");
-        // printfHex32(tasks[currentTask]->GetID());
-        // printf(", ");
+        Task *task = tasks[currentTask];
+        task->cpustate = cpustate; // Save the CPU state of the task
         if (cpustate->eax == 7) // waitpid
         {
-            // printf("Called waitpid, ");
-            tasks[currentTask]->state = TaskState::BLOCKED;
-            tasks[currentTask]->waitingPid = cpustate->ebx;
-            // printf("Waiting for PID: ");
-            // printfHex32(cpustate->ebx);
-            // printf(", ");
+            Task *target = GetTask(cpustate->ebx);
+            task->waitingPid = cpustate->ebx;
+            if (target != 0 && target->state != TaskState::EXITED)
+            {
+                task->state = TaskState::BLOCKED;
+            }
+            else
+            {
+                task->state = TaskState::READY;
+                taskQueue.enqueue(task->id, Key(task));
+            }
         }
         else if (cpustate->eax == 1) // exit
         {
-            // printf("Called exit, ");
-            tasks[currentTask]->state = TaskState::EXITED;
+            task->state = TaskState::EXITED;
+            WakeWaiters(task->id);
         }
         else
         {
-            tasks[currentTask]->state = TaskState::READY;
+            task->state = TaskState::READY;
+            taskQueue.enqueue(task->id, Key(task));
         }
-        tasks[currentTask]->cpustate = cpustate; // Save the CPU state of the task
+    }
+    else
+    {
+        idleState = cpustate;
     }
 
     FindNextTask();
-    // for (int i = 0; i < 5000000; i++)
-    // {
-    //     printf("");
-    // }
-    // printf("New Task PID: ");
-    // printfHex32(tasks[currentTask]->GetID());
-    // printf("\n");
 
-    return tasks[currentTask]->cpustate;
+    return currentTask >= 0 ? tasks[currentTask]->cpustate : idleState;
 }
 
 /**
@@ -216,14 +227,24 @@ void myos::TaskManager::SignalEnter()
     waitingEnter = false;
 }
 
+/**
+ * Switches to priority scheduling and re-keys the READY tasks accordingly.
+ */
 void myos::TaskManager::HavePriority()
 {
     checkPriority = true;
+    for (int i = 0; i < numTasks; i++)
+        taskQueue.setPriority(i, Key(tasks[i]));
 }
 
+/**
+ * Switches back to round-robin scheduling and re-keys the READY tasks accordingly.
+ */
 void myos::TaskManager::DontHavePriority()
 {
     checkPriority = false;
+    for (int i = 0; i < numTasks; i++)
+        taskQueue.setPriority(i, Key(tasks[i]));
 }
 
 /**
@@ -0,0 +1,31 @@
+#ifndef __MYOS__BENCHMARK_H
+#define __MYOS__BENCHMARK_H
+
+#include <common/types.h>
+
+namespace myos
+{
+    // Cycle counts of one measured operation, read with rdtsc and reported as min, median and 99th percentile
+    class Benchmark
+    {
+    public:
+        static const int MAX_SAMPLES = 1024;
+
+    private:
+        char *name;
+        common::uint32_t samples[MAX_SAMPLES];
+        int count;
+
+    public:
+        Benchmark(char *name);
+        ~Benchmark();
+
+        static common::uint64_t Now();
+        void Record(common::uint32_t cycles);
+        void Reset();
+        int GetCount();
+        void Report();
+    };
+}
+
+#endif
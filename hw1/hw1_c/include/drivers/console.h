@@ -0,0 +1,75 @@
+#ifndef __MYOS__DRIVERS__CONSOLE_H
+#define __MYOS__DRIVERS__CONSOLE_H
+
+#include <common/types.h>
+#include <drivers/serial.h>
+#include <hardwarecommunication/port.h>
+#include <multitasking.h>
+#include <spinlock.h>
+
+namespace myos
+{
+    namespace drivers
+    {
+
+        // Text console on the 80x25 VGA screen, optionally mirrored to a serial port.
+        // Text is rendered into a ring of lines in memory that also holds the scrollback, and only
+        // the rows that changed are copied to video memory, once per write. Scrolling advances the ring,
+        // so it costs one block move of the screen instead of moving every character.
+        // Tasks printing with interrupts on go through a line buffer in their Task, so a line reaches
+        // the screen in one piece and lines of different tasks do not interleave.
+        class Console
+        {
+        public:
+            static const int WIDTH = 80;
+            static const int HEIGHT = 25;
+            static const int SCROLLBACK_LINES = 200; // lines kept, including the visible ones
+            static const common::uint8_t ATTRIBUTE = 0x07; // light grey on black
+
+        private:
+            common::uint16_t *videoMemory;
+            common::uint16_t lines[SCROLLBACK_LINES][WIDTH];
+            int topLine;    // ring index of the first screen row
+            int history;    // lines above topLine still in the ring
+            int cursorX;
+            int cursorY;
+            int viewOffset; // lines the view is scrolled back, 0 follows the output
+            int dirtyFirst; // screen rows to copy to video memory, none if dirtyFirst > dirtyLast
+            int dirtyLast;
+            int cursorPosition; // last position written to the hardware cursor
+            int highlightX;     // cell shown inverted, the mouse pointer
+            int highlightY;
+            SerialPort *serial;
+            bool screen;
+            Spinlock lock;
+            myos::hardwarecommunication::Port8Bit cursorIndexPort;
+            myos::hardwarecommunication::Port8Bit cursorDataPort;
+
+            static void Copy(common::uint16_t *destination, common::uint16_t *source, int cells);
+            void MarkDirty(int first, int last);
+            void NewLine();
+            void Render(char *str);
+            void Update();
+            void WriteThrough(char *str);
+
+        public:
+            static Console *activeConsole;
+
+            Console();
+            ~Console();
+
+            void Write(char *str);
+            void Write(Task *task, char *str);
+            void Flush(Task *task);
+            void Flush();
+            void Drain();
+            void ScrollView(int lines);
+            void SetHighlight(int x, int y);
+            void SetSerial(SerialPort *serial);
+            void SetScreen(bool screen);
+        };
+
+    }
+}
+
+#endif
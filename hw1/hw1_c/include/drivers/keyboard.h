@@ -15,6 +15,10 @@ namespace myos
         class KeyboardEventHandler
         {
         public:
+            // control characters passed for the keys that have none
+            static const char PAGE_UP = 0x11;
+            static const char PAGE_DOWN = 0x12;
+
             KeyboardEventHandler();
 
             virtual void OnKeyDown(char);
@@ -0,0 +1,40 @@
+#ifndef __MYOS__DRIVERS__PIT_H
+#define __MYOS__DRIVERS__PIT_H
+
+#include <common/types.h>
+#include <drivers/driver.h>
+#include <hardwarecommunication/port.h>
+
+namespace myos
+{
+    namespace drivers
+    {
+
+        // Channel 0 of the 8253/8254 programmable interval timer, wired to IRQ0.
+        // Channel 2 serves as a busy-wait delay while interrupts are not running yet.
+        class ProgrammableIntervalTimer : public Driver
+        {
+            myos::hardwarecommunication::Port8Bit channel0port;
+            myos::hardwarecommunication::Port8Bit commandport;
+
+            myos::common::uint32_t frequency;
+            myos::common::uint16_t divisor;
+            bool active;
+
+        public:
+            static const myos::common::uint32_t BASE_FREQUENCY = 1193182;
+
+            ProgrammableIntervalTimer(myos::common::uint32_t frequency);
+            ~ProgrammableIntervalTimer();
+
+            virtual void Activate();
+            void SetFrequency(myos::common::uint32_t frequency);
+            myos::common::uint32_t GetFrequency();
+
+            static void Delay(myos::common::uint32_t microseconds);
+        };
+
+    }
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef __MYOS__DRIVERS__SERIAL_H
+#define __MYOS__DRIVERS__SERIAL_H
+
+#include <common/types.h>
+#include <drivers/driver.h>
+#include <drivers/keyboard.h>
+#include <hardwarecommunication/interrupts.h>
+#include <hardwarecommunication/port.h>
+#include <spinlock.h>
+
+namespace myos
+{
+    namespace drivers
+    {
+
+        // 16550 UART on COM1 (IRQ4) as a console. Write only copies into a ring buffer,
+        // the transmit interrupt drains it into the 16-byte FIFO, so writers do not wait for the line.
+        // Received characters are passed to a keyboard handler, so a headless console can also be typed into.
+        class SerialPort : public myos::hardwarecommunication::InterruptHandler, public Driver
+        {
+        public:
+            static const common::uint16_t COM1 = 0x3F8;
+            static const common::uint32_t BAUD_RATE = 115200;
+            static const int FIFO_SIZE = 16;
+            static const int BUFFER_SIZE = 4096;
+
+        private:
+            myos::hardwarecommunication::Port8Bit dataport;
+            myos::hardwarecommunication::Port8Bit interruptEnablePort;
+            myos::hardwarecommunication::Port8Bit fifoControlPort; // interrupt identification on reads
+            myos::hardwarecommunication::Port8Bit lineControlPort;
+            myos::hardwarecommunication::Port8Bit modemControlPort;
+            myos::hardwarecommunication::Port8Bit lineStatusPort;
+
+            KeyboardEventHandler *handler;
+            char buffer[BUFFER_SIZE]; // characters not handed to the FIFO yet
+            int bufferStart;
+            int bufferLength;
+            bool transmitting;        // the transmit interrupt is enabled and will drain the buffer
+            bool active;
+            Spinlock lock;
+
+            void Put(char c);
+            void FillFifo();
+
+        public:
+            SerialPort(myos::hardwarecommunication::InterruptManager *manager, KeyboardEventHandler *handler);
+            ~SerialPort();
+
+            virtual void Activate();
+            virtual common::uint32_t HandleInterrupt(common::uint32_t esp);
+            void Write(char *str);
+            void Drain();
+        };
+
+    }
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef __MYOS__DRIVERS__TERMINAL_H
+#define __MYOS__DRIVERS__TERMINAL_H
+
+#include <common/types.h>
+#include <drivers/keyboard.h>
+#include <multitasking.h>
+#include <spinlock.h>
+
+namespace myos
+{
+    namespace drivers
+    {
+
+        // Line discipline of the console (tty): echoes the typed keys, edits the current line
+        // with backspace and queues complete lines for the read syscall on file descriptor 0.
+        // A task reading with no complete line queued sleeps until the keyboard interrupt brings one.
+        class Terminal : public KeyboardEventHandler
+        {
+        public:
+            static const int BUFFER_SIZE = 256;
+
+        private:
+            char line[BUFFER_SIZE];  // the line being typed
+            int lineLength;
+            char input[BUFFER_SIZE]; // ring buffer of complete lines not read yet
+            int inputStart;
+            int inputLength;
+            volatile common::uint32_t lines; // complete lines in input, readers sleep on it
+            Spinlock lock;
+
+        public:
+            static Terminal *activeTerminal;
+
+            Terminal();
+            ~Terminal();
+
+            virtual void OnKeyDown(char c);
+            int Read(char *buffer, int size);
+            CPUState *Read(TaskManager *taskManager, CPUState *cpustate);
+        };
+
+    }
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef __MYOS__FPU_H
+#define __MYOS__FPU_H
+
+#include <common/types.h>
+#include <hardwarecommunication/interrupts.h>
+#include <multitasking.h>
+
+namespace myos
+{
+    // x87/SSE register state, switched lazily: after a task switch CR0.TS is set, and the first
+    // FPU or SSE instruction of the new task raises #NM (exception 7), which loads the task's state.
+    // Tasks that never touch the FPU never pay for saving or restoring it.
+    class FloatingPointUnit : public hardwarecommunication::InterruptHandler
+    {
+        TaskManager *taskManager;
+
+        static bool fxsr; // FXSAVE/FXRSTOR are available, which also covers the SSE registers
+        static bool sse;
+
+    public:
+        static const int STATE_SIZE = 512; // size of an FXSAVE area, FNSAVE needs 108 bytes
+
+        FloatingPointUnit(hardwarecommunication::InterruptManager *interruptManager, TaskManager *taskManager);
+        ~FloatingPointUnit();
+
+        virtual common::uint32_t HandleInterrupt(common::uint32_t esp);
+
+        static bool Enable();
+        static void Initialize();
+        static void Save(common::uint8_t *state);
+        static void Restore(common::uint8_t *state);
+        static void SetTaskSwitched();
+        static void ClearTaskSwitched();
+        static bool IsTaskSwitched();
+    };
+}
+
+#endif
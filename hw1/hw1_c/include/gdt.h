@@ -36,6 +36,7 @@ namespace myos
 
             GlobalDescriptorTable();
             ~GlobalDescriptorTable();
+            void Load();
 
             myos::common::uint16_t CodeSegmentSelector();
             myos::common::uint16_t DataSegmentSelector();
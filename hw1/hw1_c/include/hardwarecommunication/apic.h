@@ -0,0 +1,56 @@
+#ifndef __MYOS__HARDWARECOMMUNICATION__APIC_H
+#define __MYOS__HARDWARECOMMUNICATION__APIC_H
+
+#include <common/types.h>
+
+namespace myos
+{
+    namespace hardwarecommunication
+    {
+
+        // The local APIC of the processor executing the code. Every processor sees its own
+        // local APIC at the same physical address, so the class only holds that address.
+        class LocalAPIC
+        {
+            static volatile common::uint32_t *registers; // 0 until Enable
+
+            static common::uint32_t Read(common::uint32_t reg);
+            static void Write(common::uint32_t reg, common::uint32_t value);
+            static void SendInterProcessorInterrupt(common::uint8_t apicId, common::uint32_t command);
+
+        public:
+            static const common::uint32_t DEFAULT_BASE = 0xFEE00000;
+            static const common::uint8_t SPURIOUS_VECTOR = 0xFF;
+
+            static void Enable(common::uint32_t base, bool bootProcessor);
+            static bool IsEnabled();
+            static common::uint8_t ID();
+            static void EndOfInterrupt();
+            static void SendInit(common::uint8_t apicId);
+            static void SendStartup(common::uint8_t apicId, common::uint8_t page);
+            static common::uint32_t CalibrateTimer(common::uint32_t hz);
+            static void StartTimer(common::uint8_t vector, common::uint32_t initialCount);
+        };
+
+        // An I/O APIC, routing external interrupt lines (pins) to the local APICs.
+        // Device interrupts go through the 8259 PICs, so it is only ever masked.
+        class IOAPIC
+        {
+            volatile common::uint32_t *registers;
+
+            common::uint32_t Read(common::uint8_t reg);
+            void Write(common::uint8_t reg, common::uint32_t value);
+
+        public:
+            IOAPIC(common::uint32_t base);
+            ~IOAPIC();
+
+            int GetNumPins();
+            void Mask(int pin);
+            void MaskAll();
+        };
+
+    }
+}
+
+#endif
@@ -33,6 +33,8 @@ namespace myos
             protected:
 
                 static InterruptManager* ActiveInterruptManager;
+                static myos::common::uint32_t processorStacks[256];      // interrupt stack top per local APIC ID, 0 for none
+                static volatile myos::common::uint32_t *apicIdRegister;   // set once interrupt stacks are in use
                 InterruptHandler* handlers[256];
                 TaskManager *taskManager;
 
@@ -77,6 +79,7 @@ namespace myos
                 static void HandleInterruptRequest0x0D();
                 static void HandleInterruptRequest0x0E();
                 static void HandleInterruptRequest0x0F();
+                static void HandleInterruptRequest0x20();
                 static void HandleInterruptRequest0x31();
 
                 static void HandleInterruptRequest0x80();
@@ -110,12 +113,22 @@ namespace myos
                 Port8BitSlow programmableInterruptControllerSlaveCommandPort;
                 Port8BitSlow programmableInterruptControllerSlaveDataPort;
 
+                bool tickless;
+                bool timerMasked;
+                void SetTimerMasked(bool masked);
+
             public:
+                static const myos::common::uint8_t LOCAL_TIMER_IRQ = 0x20; // the local APIC timer, above the 16 IRQs of the 8259s
+
                 InterruptManager(myos::common::uint16_t hardwareInterruptOffset, myos::GlobalDescriptorTable* globalDescriptorTable, myos::TaskManager* taskManager);
                 ~InterruptManager();
                 myos::common::uint16_t HardwareInterruptOffset();
                 void Activate();
+                void ActivateProcessor();
                 void Deactivate();
+                static void SetProcessorStack(myos::common::uint8_t apicId, myos::common::uint32_t esp);
+                static void EnableProcessorStacks(myos::common::uint32_t localApicAddress);
+                void SetTickless(bool tickless);
         };
         
     }
@@ -1,8 +1,9 @@
- 
 #ifndef __MYOS__MEMORYMANAGEMENT_H
 #define __MYOS__MEMORYMANAGEMENT_H
 
 #include <common/types.h>
+#include <spinlock.h>
+#include <pageframe.h>
 
 
 namespace myos
@@ -10,22 +11,47 @@ namespace myos
     
     struct MemoryChunk
     {
-        MemoryChunk *next;
+        MemoryChunk *next; // neighbours in address order, for merging
         MemoryChunk *prev;
         bool allocated;
         common::size_t size;
+        MemoryChunk *nextFree; // the free list of the size class, only while the chunk is free
+        MemoryChunk *prevFree;
     };
     
     
+    // Two-level segregated fit heap (TLSF). Free chunks are kept in lists by size class:
+    // the first level is the power of two below the size, the second level splits it into
+    // SECOND_LEVEL_COUNT equal ranges. Bitmaps of the non-empty lists make malloc and free O(1).
+    // The heap consists of regions, each a chain of neighbouring chunks. When no chunk is large
+    // enough, a new region is taken from the page frame allocator.
     class MemoryManager
     {
+    public:
+        static const int FIRST_LEVEL_COUNT = 32;
+        static const int SECOND_LEVEL_LOG2 = 3;
+        static const int SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_LOG2;
+        static const common::size_t ALIGNMENT = 8; // also the smallest chunk
+        static const common::size_t GROWTH = 1024 * 1024; // smallest region taken from the page frame allocator
         
     protected:
         MemoryChunk* first;
+        common::uint32_t firstLevelBitmap;
+        common::uint32_t secondLevelBitmap[FIRST_LEVEL_COUNT];
+        MemoryChunk* freeLists[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+        Spinlock lock; // the heap is shared by all processors and by interrupt handlers
+        
+        static void Mapping(common::size_t size, int *firstLevel, int *secondLevel);
+        void InsertFree(MemoryChunk *chunk);
+        void RemoveFree(MemoryChunk *chunk);
+        MemoryChunk* FindFree(common::size_t size);
+        void AddRegion(common::size_t start, common::size_t size);
+        bool Grow(common::size_t size);
     public:
         
         static MemoryManager *activeMemoryManager;
         
+        MemoryManager();
         MemoryManager(common::size_t first, common::size_t size);
         ~MemoryManager();
         
@@ -43,7 +69,8 @@ void* operator new(unsigned size, void* ptr);
 void* operator new[](unsigned size, void* ptr);
 
 void operator delete(void* ptr);
+void operator delete(void* ptr, unsigned size);
 void operator delete[](void* ptr);
 
 
-#endif
\ No newline at end of file
+#endif 
@@ -4,7 +4,11 @@
 
 #include <common/types.h>
 #include <gdt.h>
-#include <queue.h>
+#include <memorymanagement.h>
+#include <slab.h>
+#include <timerwheel.h>
+#include <scheduler.h>
+#include <spinlock.h>
 
 namespace myos
 {
@@ -13,6 +17,7 @@ namespace myos
         RUNNING,
         READY,
         BLOCKED,
+        SLEEPING,
         EXITED
     };
 
@@ -33,6 +38,7 @@ namespace myos
         common::uint32_t es;
         common::uint32_t ds;
         */
+        common::uint32_t interrupt;
         common::uint32_t error;
 
         common::uint32_t eip;
@@ -42,51 +48,260 @@ namespace myos
         common::uint32_t ss;
     } __attribute__((packed));
 
+    class Task;
+    class Mutex;
+
+    namespace drivers
+    {
+        class Console;
+    }
+
+    // Tasks BLOCKED on a futex word or a mutex, highest (effective) priority first, FIFO among equals
+    class WaitQueue
+    {
+        Task *head;
+
+    public:
+        WaitQueue();
+        ~WaitQueue();
+
+        void Push(Task *task);
+        Task *Pop();
+        void Remove(Task *task);
+        Task *Front();
+        bool IsEmpty();
+    };
+
+    // Scheduling state of one processor
+    struct Processor
+    {
+        common::uint8_t apicId;
+        int currentTask;          // PID of the running task, -1 while the idle context runs
+        Task *reapedTask;         // exited task whose stack is still in use until the next switch
+        Task *idleTask;           // runs when no task is ready, not part of the task table
+        CPUState *idleState;      // saved context of the idle task, or of kernelMain if there is none
+        bool idling;              // the idle context is the one currently running
+        common::size_t idleTicks;
+        SchedulerPolicy *policy;  // run queue of this processor
+        int numReady;             // tasks in the run queue
+        Task *fpuOwner;           // task whose FPU state is loaded in the registers, 0 if none
+    };
+
+    // CPU accounting of a task, times are in clock ticks
+    struct TaskStatistics
+    {
+        int pid;
+        TaskState state;
+        int priority;
+        int tickets;
+        common::uint32_t runningTicks;
+        common::uint32_t readyTicks;
+        common::uint32_t blockedTicks; // BLOCKED or SLEEPING
+        common::uint32_t switches;     // times the task gave up the CPU
+        common::uint32_t voluntarySwitches;
+        common::uint32_t involuntarySwitches;
+        common::uint32_t arrivalTick;  // clock tick the task was added
+        common::uint32_t firstRunTick; // clock tick the task first ran, if started
+        common::uint32_t exitTick;     // clock tick the task exited, once EXITED
+        bool started;
+    };
+
+    // A block of the arena of a task, handed out from the front by task_alloc
+    struct ArenaChunk
+    {
+        ArenaChunk *next;
+        common::uint8_t *top; // the next free byte
+        common::uint8_t *end;
+    };
+
+    // Links a waiting task into the waiter list of one task it waits for
+    struct WaitQueueEntry
+    {
+        Task *task;   // the waiting task
+        Task *target; // the task waited for, 0 if the entry is unused
+        WaitQueueEntry *prev;
+        WaitQueueEntry *next;
+    };
+
     class Task
     {
         friend class TaskManager;
+        friend class RunQueue;
+        friend class SchedulerPolicy;
+        friend class WaitQueue;
+        friend class drivers::Console;
+
+    public:
+        static const int MAX_WAIT = 16; // tasks a single wait can cover
+        static const int OUTPUT_BUFFER_SIZE = 160; // printed characters held back until a newline
+        static const common::size_t ARENA_CHUNK_SIZE = 4096; // bytes taken from the heap at once by task_alloc
 
     private:
         common::uint8_t stack[4096]; // 4 KiB
         CPUState *cpustate;
         int id;
-        int waitingPid;
+        int parentPid = -1;
+        WaitQueueEntry waitEntries[MAX_WAIT]; // entries of this task in other tasks' waiter lists
+        WaitQueueEntry *waiters = 0;           // tasks blocked until this task exits
+        int waitCount = 0;                     // exits still needed before this task is woken
         TaskState state = TaskState::READY;
         int priority = 0;
+        Task *nextReady = 0;              // link in a run queue of the scheduler policy
+        Task *policyChild = 0;            // first child in a heap of the scheduler policy
+        int policyLevel = 0;              // run queue level chosen by the scheduler policy
+        common::uint32_t policyEpoch = 0; // policy specific generation of policyLevel
+        int tickets = 100;                // share of the CPU under proportional-share scheduling
+        common::uint32_t pass = 0;        // virtual time of the task under stride scheduling
+        common::uint32_t timeSlice = 0; // clock ticks left before the task is preempted
+        int processor = 0;              // processor whose run queue the task is in, or last ran on
+        TimerEntry sleepTimer;          // wakes the task while it is SLEEPING
+        common::uint32_t period = 0;    // clock ticks between deadlines, 0 outside the deadline class
+        common::uint32_t budget = 0;    // clock ticks of CPU time granted per period
+        common::uint32_t runtime = 0;   // budget left in the current period
+        common::uint32_t deadline = 0;  // clock tick the current period ends at
+        common::uint32_t utilization = 0; // budget / period, in units of 1 / TaskManager::FULL_UTILIZATION
+        bool throttled = false;         // READY, but out of budget until the next period
+        TimerEntry releaseTimer;        // starts the next period of a deadline task
+        TaskStatistics statistics;
+        common::size_t stateSince = 0;  // clock tick of the last state change
+        WaitQueue *waitQueue = 0;       // futex or mutex queue the task is BLOCKED in
+        Task *nextWaiter = 0;           // link in waitQueue
+        volatile common::uint32_t *futexAddress = 0; // word the task waits on, 0 for a mutex
+        Mutex *blockedOn = 0;           // mutex the task waits for
+        Mutex *heldMutexes = 0;         // mutexes owned by the task, linked through Mutex::nextHeld
+        int inheritedPriority = -1;     // highest effective priority of the tasks waiting for heldMutexes
+        bool restartSyscall = false;    // the syscall the task sleeps in runs again once it is woken
+        common::uint8_t fpuArea[512 + 15]; // holds the 16-byte aligned FXSAVE area fpuState
+        common::uint8_t *fpuState;
+        bool fpuUsed = false;           // fpuState is valid, the task has executed an FPU or SSE instruction
+        int fpuProcessor = -1;          // processor the FPU state was last loaded on
+        char output[OUTPUT_BUFFER_SIZE + 1]; // line buffer of the console, zero-terminated when written out
+        int outputLength = 0;
+        char *input = 0;                // scripted lines read instead of the console, 0 for none
+        ArenaChunk *arena = 0;          // memory of task_alloc, released as a whole when the task exits
+
+        int EffectivePriority();
+
+        static SlabCache cache; // Task objects churn with every fork and exit
 
     public:
         common::uint32_t locals[64];
         Task(GlobalDescriptorTable *gdt, void entrypoint());
         Task(common::uint32_t esp);
+        static void *operator new(common::size_t size) throw(); // may return 0, which skips the constructor
+        static void operator delete(void *ptr);
         int GetID();
         void SetPriority(int priority);
         int GetPriority();
+        void SetTickets(int tickets);
+        int GetTickets();
         TaskState GetState();
+        void SetInput(char *input);
+        int ReadInput(char *buffer, int size);
+        void *Allocate(common::size_t size);
+        void ReleaseArena();
         ~Task();
     };
 
     class TaskManager
     {
+    public:
+        static const int NUM_PRIORITIES = 32;
+        static const common::uint32_t DEFAULT_QUANTUM = 10; // clock ticks
+        static const common::uint32_t FULL_UTILIZATION = 1 << 16;
+        static const common::uint32_t MAX_PERIOD = (1 << 16) - 1; // clock ticks
+        static const int MAX_PROCESSORS = 16;
+        static const int FUTEX_BUCKETS = 64;
+        static const int MAX_INHERITANCE_DEPTH = 8; // length of the mutex chains priority inheritance follows
+
+        static TaskManager *activeTaskManager;
+
     private:
-        Task *tasks[256];
-        int numTasks;
-        int currentTask;
-        void FindNextTask();
+        Task **tasks;    // indexed by PID, 0 for unused PIDs
+        int *freePids;   // stack of PIDs released by reaped tasks
+        int capacity;    // size of tasks and freePids
+        int numTasks;    // PIDs handed out so far, including released ones
+        int numFreePids;
+        Spinlock lock;   // all of the scheduler state, shared by the processors
+        Processor processors[MAX_PROCESSORS];
+        int numProcessors;
+        common::uint8_t processorOfApic[256]; // processor index by local APIC ID
+        Processor *CurrentProcessor();
+        Task *CurrentTask();
+        void FindNextTask(Processor *processor);
+        Task *Steal(Processor *processor);
+        Processor *LeastLoaded();
+        void SetState(Task *task, TaskState state);
         bool waitingEnter = false;
-        bool checkPriority = false;
         common::size_t clockCounter = 0;
-        PriorityQueue taskQueue;
+
+        PriorityPolicy defaultPolicy;
+        common::uint32_t quantum[NUM_PRIORITIES]; // time slice length per priority, in clock ticks
+        common::uint32_t tickRate = 18;           // clock ticks per second, the BIOS default until set
+        TimerWheel timers;
+        Task *deadlineQueue = 0;                  // READY deadline tasks, earliest deadline first
+        common::uint32_t deadlineUtilization = 0; // sum of the utilization of the admitted deadline tasks
+        WaitQueue futexQueues[FUTEX_BUCKETS]; // futex waiters, hashed by the address of the word
+        void Enqueue(Task *task);
+        void Reprioritize(Task *task);
+        void Unblock(Task *task, common::uint32_t result);
+        void SleepOn(Task *task, volatile common::uint32_t *address, common::uint32_t timeoutMs);
+        void Acquire(Task *task, Mutex *mutex);
+        Task *HandOff(Mutex *mutex);
+        bool UpdateInheritedPriority(Task *task);
+        void Inherit(Mutex *mutex);
+        bool Wait(Task *task, int *pids, int n, bool any);
+        void CancelWait(Task *task);
+        bool WakeWaiters(Task *target);
+        common::uint32_t MillisecondsToTicks(common::uint32_t ms);
+        void EnqueueDeadline(Task *task);
+        void Release(Task *task);
+        bool DeadlineTick(Task *running);
+        void Tick();
+        bool Grow();
+        bool Insert(Task *task);
+        void Reap(Task *task);
+        void ExitTask(Task *task);
+        void FreeReapedTask(Processor *processor);
+        Task *EnterSyscall(Processor *processor, CPUState *cpustate);
+        CPUState *Switch(Processor *processor, Task *task, CPUState *cpustate);
 
     public:
         TaskManager();
         ~TaskManager();
+        void SetPolicy(SchedulerPolicy *policy);
+        int AddProcessor(common::uint8_t apicId, Task *idleTask);
+        int GetNumProcessors();
         bool AddTask(Task *task);
         CPUState *Schedule(CPUState *cpustate);
+        CPUState *Yield(CPUState *cpustate);
+        CPUState *Exit(CPUState *cpustate);
+        CPUState *WaitPids(CPUState *cpustate, int *pids, int n, bool any);
+        CPUState *Sleep(CPUState *cpustate, common::uint32_t ms);
+        CPUState *FutexWait(CPUState *cpustate, volatile common::uint32_t *address, common::uint32_t value, common::uint32_t timeoutMs);
+        int FutexWake(volatile common::uint32_t *address, int n);
+        CPUState *WaitAndRestart(CPUState *cpustate, volatile common::uint32_t *address, common::uint32_t value);
+        void LoadFloatingPointState();
+        CPUState *LockMutex(CPUState *cpustate, Mutex *mutex);
+        int TryLockMutex(Mutex *mutex);
+        CPUState *UnlockMutex(CPUState *cpustate, Mutex *mutex);
         Task *GetCurrentTask();
+        void SetIdleTask(Task *task);
+        bool IsIdle();
+        bool HasReadyTask();
+        bool HasTimers();
         void SetPriority(int priority);
+        void SetTickets(int tickets);
+        int SetDeadline(common::uint32_t periodMs, common::uint32_t budgetMs);
         int GetNumTasks();
         Task *GetTask(int id);
         common::size_t GetClockCounter();
+        common::size_t GetIdleTicks();
+        int GetStatistics(int pid, TaskStatistics *statistics);
+        void SetTickRate(common::uint32_t hz);
+        common::uint32_t GetTickRate();
+        void SetQuantum(int priority, common::uint32_t ticks);
+        common::uint32_t GetQuantum(int priority);
         void WaitEnter();
         void SignalEnter();
         void HavePriority();
@@ -95,4 +310,6 @@ namespace myos
     };
 }
 
+void *task_alloc(myos::common::size_t size);
+
 #endif
\ No newline at end of file
@@ -35,7 +35,7 @@ namespace myos
             
             common::uint32_t IPcache[128];
             common::uint64_t MACcache[128];
-            int numCacheEntries;
+            volatile common::uint32_t numCacheEntries; // Resolve sleeps on it until a response is cached
             
         public:
             AddressResolutionProtocol(EtherFrameProvider* backend);
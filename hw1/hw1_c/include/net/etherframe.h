@@ -6,6 +6,7 @@
 #include <common/types.h>
 #include <drivers/amd_am79c973.h>
 #include <memorymanagement.h>
+#include <slab.h>
 
 
 namespace myos
@@ -47,7 +48,13 @@ namespace myos
         friend class EtherFrameHandler;
         protected:
             EtherFrameHandler* handlers[65535];
+            static SlabCache packetBuffers;
         public:
+            static const common::uint32_t PACKET_BUFFER_SIZE = 1536; // a whole frame
+            
+            static common::uint8_t* AllocateBuffer(common::uint32_t size);
+            static void FreeBuffer(common::uint8_t* buffer, common::uint32_t size);
+            
             EtherFrameProvider(drivers::amd_am79c973* backend);
             ~EtherFrameProvider();
             
@@ -103,12 +103,18 @@ namespace myos
             TransmissionControlProtocolHandler* handler;
             
             TransmissionControlProtocolSocketState state;
+            static SlabCache cache;
+
+            void SetState(TransmissionControlProtocolSocketState state);
         public:
             TransmissionControlProtocolSocket(TransmissionControlProtocolProvider* backend);
+            static void* operator new(common::size_t size) throw(); // may return 0, which skips the constructor
+            static void operator delete(void* ptr);
             ~TransmissionControlProtocolSocket();
             virtual bool HandleTransmissionControlProtocolMessage(common::uint8_t* data, common::uint16_t size);
-            virtual void Send(common::uint8_t* data, common::uint16_t size);
+            virtual bool Send(common::uint8_t* data, common::uint16_t size);
             virtual void Disconnect();
+            TransmissionControlProtocolSocketState GetState();
         };
       
       
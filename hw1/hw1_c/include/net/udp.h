@@ -48,8 +48,11 @@ namespace myos
             UserDatagramProtocolProvider* backend;
             UserDatagramProtocolHandler* handler;
             bool listening;
+            static SlabCache cache;
         public:
             UserDatagramProtocolSocket(UserDatagramProtocolProvider* backend);
+            static void* operator new(common::size_t size) throw(); // may return 0, which skips the constructor
+            static void operator delete(void* ptr);
             ~UserDatagramProtocolSocket();
             virtual void HandleUserDatagramProtocolMessage(common::uint8_t* data, common::uint16_t size);
             virtual void Send(common::uint8_t* data, common::uint16_t size);
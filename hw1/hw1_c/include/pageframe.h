@@ -0,0 +1,60 @@
+#ifndef __MYOS__PAGEFRAME_H
+#define __MYOS__PAGEFRAME_H
+
+#include <common/types.h>
+#include <spinlock.h>
+
+namespace myos
+{
+    // Buddy allocator of physical page frames, filled from the multiboot memory map.
+    // A block of order k is 2^k pages, aligned to its size. Freeing a block merges it with its buddy,
+    // the other half of the block of order k + 1, as long as that is free too.
+    // Allocating and freeing take O(MAX_ORDER) steps.
+    class PageFrameAllocator
+    {
+    public:
+        static const common::uint32_t PAGE_SIZE = 4096;
+        static const int PAGE_SHIFT = 12;
+        static const int MAX_ORDER = 10; // blocks of up to 4 MiB
+
+        static PageFrameAllocator *activePageFrameAllocator;
+
+        PageFrameAllocator(const void *multiboot_structure, common::size_t kernelEnd);
+        ~PageFrameAllocator();
+
+        void *AllocatePages(int order);
+        void FreePages(void *address, int order);
+        common::uint32_t FreeFrames();
+        common::uint32_t TotalFrames();
+
+        static int Order(common::size_t size);
+
+    private:
+        static const common::uint8_t FREE = 0x80;
+        static const int MAX_RESERVED = 8; // kernel, multiboot information, cmdline, memory map, frame table and spare
+
+        struct FreeBlock
+        {
+            FreeBlock *next;
+            FreeBlock *prev;
+        };
+
+        FreeBlock *freeLists[MAX_ORDER + 1];
+        common::uint8_t *frames; // FREE | order for the first frame of a free block, 0 for all others
+        common::uint32_t numFrames;
+        common::uint32_t freeFrames;
+        common::uint32_t totalFrames;
+        Spinlock lock;
+
+        // memory that must not be handed out, as [start, end) pairs
+        common::uint32_t reserved[MAX_RESERVED][2];
+        int numReserved;
+
+        void Reserve(common::uint32_t start, common::uint32_t end);
+        void AddRange(common::uint32_t start, common::uint32_t end);
+        void Insert(common::uint32_t frame, int order);
+        void Remove(common::uint32_t frame, int order);
+    };
+}
+
+#endif
@@ -5,18 +5,21 @@
 
 namespace myos
 {
-    // Node structure for the priority queue
+    // Node structure for the priority queue, one per possible data value
     struct Node
     {
         int data;
         int priority;
-        Node *next;
+        common::uint32_t sequence; // insertion order, breaks ties between equal priorities
+        int position;              // index in the heap, -1 if not queued
     };
 
-    // Priority Queue class
+    // Indexed binary max-heap over the integers [0, CAPACITY)
     class PriorityQueue
     {
     public:
+        static const int CAPACITY = 256;
+
         // Constructor
         PriorityQueue();
 
@@ -26,8 +29,14 @@ namespace myos
         // Check if the priority queue is empty
         bool isEmpty();
 
-        // Insert an element with a given priority
-        void enqueue(int data, int priority);
+        // Number of queued elements
+        int size();
+
+        // Check if an element is queued
+        bool contains(int data);
+
+        // Insert an element with a given priority, fails if data is out of range or already queued
+        bool enqueue(int data, int priority);
 
         // Remove and return the element with the highest priority
         int dequeue();
@@ -35,11 +44,23 @@ namespace myos
         // Get the element with the highest priority without removing it
         int peek();
 
+        // Change the priority of a queued element and restore the heap order
         void setPriority(int data, int priority);
 
+        // Remove an element from anywhere in the queue
+        void remove(int data);
+
     private:
-        Node *head; // Pointer to the head of the linked list
+        Node nodes[CAPACITY]; // fixed node pool, indexed by data
+        Node *heap[CAPACITY];
+        int count;
+        common::uint32_t nextSequence;
+
+        bool before(Node *a, Node *b);
+        void place(Node *node, int position);
+        void siftUp(int position);
+        void siftDown(int position);
     };
 }
 
-#endif // PRIORITY_QUEUE_H
\ No newline at end of file
+#endif // PRIORITY_QUEUE_H
@@ -0,0 +1,168 @@
+#ifndef __MYOS__SCHEDULER_H
+#define __MYOS__SCHEDULER_H
+
+#include <common/types.h>
+
+namespace myos
+{
+    class Task;
+    class TaskManager;
+
+    // One FIFO of READY tasks per level, bit i of the bitmap is set iff level i is non-empty
+    class RunQueue
+    {
+    public:
+        static const int LEVELS = 32;
+
+        RunQueue();
+        ~RunQueue();
+
+        void Push(Task *task, int level);
+        Task *Pop();
+        Task *PopAll();
+        bool Remove(Task *task, int level);
+        void Splice(int from, int to);
+        int Highest();
+        bool IsEmpty();
+
+    private:
+        Task *head[LEVELS];
+        Task *tail[LEVELS];
+        common::uint32_t bitmap;
+    };
+
+    // Decides which READY task runs next. TaskManager owns the task states,
+    // the policy only orders the READY tasks and decides when the running task is preempted.
+    class SchedulerPolicy
+    {
+        friend class TaskManager;
+
+    protected:
+        TaskManager *taskManager;
+
+        static int Priority(Task *task);
+        static Task *NextReady(Task *task);
+        static Task *&Sibling(Task *task);
+        static Task *&Child(Task *task);
+        static int &Level(Task *task);
+        static common::uint32_t &Epoch(Task *task);
+        static common::uint32_t &TimeSliceLeft(Task *task);
+        static int Tickets(Task *task);
+        static common::uint32_t &Pass(Task *task);
+
+    public:
+        SchedulerPolicy();
+        virtual ~SchedulerPolicy();
+
+        // A task became READY
+        virtual void Enqueue(Task *task);
+        // Removes and returns the task to run next, 0 if no task is ready
+        virtual Task *Dequeue();
+        // A clock tick passed while the given task was running (0 while idle), true to preempt it
+        virtual bool Tick(Task *running);
+        // The running task gave up the CPU before its time slice was used up
+        virtual void Block(Task *task);
+        // The time slice a task gets when it is picked, in clock ticks
+        virtual common::uint32_t TimeSlice(Task *task);
+        virtual bool HasReady();
+        // HavePriority/DontHavePriority, ignored by policies without static priorities
+        virtual void UsePriorities(bool enabled);
+        // The effective priority of a READY task changed through priority inheritance
+        virtual void Reprioritize(Task *task);
+        // A new, empty policy of the same kind and settings, for the run queue of another processor
+        virtual SchedulerPolicy *Create();
+    };
+
+    // All tasks in one FIFO, each runs for the quantum of its priority
+    class RoundRobinPolicy : public SchedulerPolicy
+    {
+        RunQueue queue;
+
+    public:
+        RoundRobinPolicy();
+        ~RoundRobinPolicy();
+
+        virtual void Enqueue(Task *task);
+        virtual Task *Dequeue();
+        virtual bool HasReady();
+        virtual SchedulerPolicy *Create();
+    };
+
+    // The highest priority READY task runs, round-robin within a priority.
+    // Until priorities are enabled it behaves like round-robin.
+    class PriorityPolicy : public SchedulerPolicy
+    {
+        RunQueue queue;
+        bool enabled;
+
+        int QueueLevel(Task *task);
+
+    public:
+        PriorityPolicy();
+        ~PriorityPolicy();
+
+        virtual void Enqueue(Task *task);
+        virtual Task *Dequeue();
+        virtual bool Tick(Task *running);
+        virtual bool HasReady();
+        virtual void UsePriorities(bool enabled);
+        virtual void Reprioritize(Task *task);
+        virtual SchedulerPolicy *Create();
+    };
+
+    // Multi-level feedback queue: tasks start at the top level, drop a level whenever they use up
+    // their time slice and climb a level whenever they block early, so I/O-bound tasks stay on top.
+    // Lower levels get longer slices. All tasks return to the top once per second against starvation.
+    class FeedbackPolicy : public SchedulerPolicy
+    {
+        RunQueue queue;
+        common::uint32_t epoch;         // incremented by every boost
+        common::uint32_t ticksSinceBoost;
+
+        void Boost();
+
+    public:
+        static const int LEVELS = 8;
+
+        FeedbackPolicy();
+        ~FeedbackPolicy();
+
+        virtual void Enqueue(Task *task);
+        virtual Task *Dequeue();
+        virtual bool Tick(Task *running);
+        virtual void Block(Task *task);
+        virtual common::uint32_t TimeSlice(Task *task);
+        virtual bool HasReady();
+        virtual SchedulerPolicy *Create();
+    };
+
+    // Stride scheduling: every task advances its pass by STRIDE / tickets per clock tick it runs,
+    // the task with the smallest pass runs next. CPU time is shared in proportion to the tickets,
+    // without starving tasks with few tickets.
+    // The READY tasks form a pairing heap on pass, linked through the tasks themselves,
+    // so enqueueing is O(1) and never allocates.
+    class StridePolicy : public SchedulerPolicy
+    {
+        Task *root; // the task with the smallest pass
+        int count;
+        common::uint32_t globalPass; // pass of the most recently picked task
+
+        bool Before(Task *a, Task *b);
+        Task *Meld(Task *a, Task *b);
+        Task *MergePairs(Task *first);
+
+    public:
+        static const common::uint32_t STRIDE = 1 << 20;
+
+        StridePolicy();
+        ~StridePolicy();
+
+        virtual void Enqueue(Task *task);
+        virtual Task *Dequeue();
+        virtual bool Tick(Task *running);
+        virtual bool HasReady();
+        virtual SchedulerPolicy *Create();
+    };
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef __MYOS__SLAB_H
+#define __MYOS__SLAB_H
+
+#include <common/types.h>
+#include <spinlock.h>
+
+namespace myos
+{
+    // Cache of objects of one size. Objects are carved from slabs, blocks of the heap holding
+    // several of them, and freed objects go to a free list of the cache instead of back to the heap,
+    // so allocating and freeing is a list operation and the heap does not fragment.
+    // Slabs are kept for the lifetime of the cache. C++ objects are constructed on top
+    // through a class operator new, see Task.
+    class SlabCache
+    {
+    public:
+        static const common::size_t SLAB_SIZE = 16384; // bytes per slab, unless a slab of MIN_OBJECTS is larger
+        static const int MIN_OBJECTS = 4;
+
+        SlabCache(char *name, common::size_t objectSize);
+        ~SlabCache();
+
+        void *Allocate();
+        void Free(void *object);
+        common::size_t ObjectSize();
+
+        static void PrintStatistics();
+
+    private:
+        char *name;
+        common::size_t objectSize;
+        int objectsPerSlab;
+        void *freeList; // linked through the first word of each free object
+        void *slabs;    // linked through the first word of each slab
+        Spinlock lock;  // objects are freed by interrupt handlers, e.g. tasks reaped by the scheduler
+
+        // statistics
+        int numSlabs;
+        int inUse;
+        int peakInUse;
+        common::uint32_t allocations;
+        common::uint32_t failures;
+
+        SlabCache *nextCache;
+        static SlabCache *caches;
+
+        bool Grow();
+    };
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef __MYOS__SMP_H
+#define __MYOS__SMP_H
+
+#include <common/types.h>
+
+namespace myos
+{
+    // Finds the processors and the I/O APIC in the MultiProcessor Specification tables of the BIOS
+    // and starts the application processors
+    class MultiProcessor
+    {
+    public:
+        static const int MAX_PROCESSORS = 16;
+        static const common::uint32_t TRAMPOLINE = 0x8000; // real mode startup code of the application processors
+        static const common::uint32_t STACK_SIZE = 16 * 1024;
+
+    private:
+        int numProcessors;
+        common::uint8_t apicIds[MAX_PROCESSORS];
+        common::uint8_t bootApicId;
+        common::uint32_t localApicAddress;
+        common::uint32_t ioApicAddress;
+        static volatile int numStarted;
+
+        void *FindFloatingPointer(common::uint32_t start, common::uint32_t length);
+        bool ParseConfiguration(common::uint32_t address);
+
+    public:
+        MultiProcessor();
+        ~MultiProcessor();
+
+        bool Detect();
+        int GetNumProcessors();
+        common::uint8_t GetAPICID(int processor);
+        common::uint8_t GetBootAPICID();
+        common::uint32_t GetLocalAPICAddress();
+        common::uint32_t GetIOAPICAddress();
+        int StartApplicationProcessors(void entrypoint());
+        static void ProcessorStarted();
+    };
+}
+
+#endif
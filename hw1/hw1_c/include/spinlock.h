@@ -0,0 +1,38 @@
+#ifndef __MYOS__SPINLOCK_H
+#define __MYOS__SPINLOCK_H
+
+#include <common/types.h>
+
+namespace myos
+{
+    // Busy-waiting lock for data shared between processors.
+    // The IrqSave variants also keep interrupts off on the holding processor,
+    // so an interrupt handler taking the same lock cannot deadlock against the code it interrupted.
+    class Spinlock
+    {
+        volatile common::uint32_t locked;
+
+    public:
+        Spinlock();
+        ~Spinlock();
+
+        void Acquire();
+        bool TryAcquire();
+        void Release();
+        common::uint32_t AcquireIrqSave();
+        void ReleaseIrqRestore(common::uint32_t flags);
+    };
+
+    // Holds a spinlock with interrupts off until the end of the enclosing scope
+    class SpinlockGuard
+    {
+        Spinlock *lock;
+        common::uint32_t flags;
+
+    public:
+        SpinlockGuard(Spinlock *lock);
+        ~SpinlockGuard();
+    };
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef __MYOS__SYNCHRONIZATION_H
+#define __MYOS__SYNCHRONIZATION_H
+
+#include <common/types.h>
+#include <multitasking.h>
+
+namespace myos
+{
+    // Sleeping on a 32-bit word. Wait only sleeps while the word still holds the expected value,
+    // checked under the scheduler lock, so a Wake between the caller's own check and the sleep is not lost.
+    // The operation numbers are those of the futex syscall (240).
+    class Futex
+    {
+    public:
+        static const common::uint32_t WAIT = 0;
+        static const common::uint32_t WAKE = 1;
+        static const common::uint32_t LOCK_PI = 6;
+        static const common::uint32_t UNLOCK_PI = 7;
+        static const common::uint32_t TRYLOCK_PI = 8;
+        static const int ALL = 0x7FFFFFFF;
+
+        // results of Wait besides 0 for a Wake
+        static const int AGAIN = -1;    // the word did not hold the expected value
+        static const int TIMED_OUT = -2; // also returned at once where the caller cannot sleep
+
+        static int Wait(volatile common::uint32_t *address, common::uint32_t value, common::uint32_t timeoutMs = 0);
+        static int Wake(volatile common::uint32_t *address, int n);
+    };
+
+    // Sleeping lock with an owner. While a task waits for the mutex, the owner runs with
+    // the waiter's priority if that is higher (priority inheritance), also along chains of mutexes.
+    // Not recursive, and not for interrupt handlers.
+    class Mutex
+    {
+        friend class TaskManager;
+
+        Task *owner;
+        Mutex *nextHeld; // next mutex held by the same owner
+        WaitQueue waiters;
+
+    public:
+        Mutex();
+        ~Mutex();
+
+        void Lock();
+        bool TryLock();
+        void Unlock();
+        bool IsLocked();
+    };
+
+    // Counting semaphore. Wait and Post do not enter the kernel unless a task has to sleep or be woken,
+    // Post and TryWait may be called from interrupt handlers.
+    class Semaphore
+    {
+        volatile common::uint32_t count;
+        volatile common::uint32_t sleepers; // tasks inside Wait that found no unit
+
+    public:
+        Semaphore(common::uint32_t count = 0);
+        ~Semaphore();
+
+        void Wait();
+        bool Wait(common::uint32_t timeoutMs);
+        bool TryWait();
+        void Post();
+        common::uint32_t GetCount();
+    };
+
+    // Waits for a condition protected by a mutex. Wakeups may be spurious, so Wait belongs in a loop
+    // that checks the condition. Signal and Broadcast may be called from interrupt handlers.
+    class ConditionVariable
+    {
+        volatile common::uint32_t sequence; // incremented by every signal
+
+    public:
+        ConditionVariable();
+        ~ConditionVariable();
+
+        void Wait(Mutex *mutex);
+        void Signal();
+        void Broadcast();
+    };
+}
+
+#endif
@@ -1,4 +1,3 @@
-
 #ifndef __MYOS__SYSCALLS_H
 #define __MYOS__SYSCALLS_H
 
@@ -9,15 +8,28 @@
 namespace myos
 {
 
+    /**
+     * A syscall, numbered by the value of eax. It returns the CPU state to resume,
+     * which is the caller's own unless the call switched tasks. Results go back in eax.
+     */
+    typedef CPUState *(*Syscall)(TaskManager *taskManager, CPUState *cpu);
+
     class SyscallHandler : public hardwarecommunication::InterruptHandler
     {
+    public:
+        static const int NUM_SYSCALLS = 352;
+
+    protected:
+        TaskManager *taskManager;
+        Syscall syscalls[NUM_SYSCALLS];
 
     public:
-        SyscallHandler(hardwarecommunication::InterruptManager *interruptManager, myos::common::uint8_t InterruptNumber);
+        SyscallHandler(hardwarecommunication::InterruptManager *interruptManager, myos::common::uint8_t InterruptNumber, TaskManager *taskManager);
         ~SyscallHandler();
+        void Register(myos::common::uint32_t number, Syscall syscall);
         virtual myos::common::uint32_t HandleInterrupt(myos::common::uint32_t esp);
     };
 
 }
 
-#endif
\ No newline at end of file
+#endif
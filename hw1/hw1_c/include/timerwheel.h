@@ -0,0 +1,47 @@
+#ifndef __MYOS__TIMERWHEEL_H
+#define __MYOS__TIMERWHEEL_H
+
+#include <common/types.h>
+
+namespace myos
+{
+    // A timer linked into one slot of a TimerWheel
+    struct TimerEntry
+    {
+        common::uint32_t expires; // absolute clock tick
+        void *data;               // owner of the timer, untouched by the wheel
+        TimerEntry *prev;
+        TimerEntry *next;
+        bool pending;
+    };
+
+    // Hierarchical timing wheel with four levels of 64 slots each.
+    // Adding and cancelling a timer is O(1), each timer is moved at most three times before it expires.
+    class TimerWheel
+    {
+    public:
+        static const int LEVELS = 4;
+        static const int SLOT_BITS = 6;
+        static const int SLOTS = 1 << SLOT_BITS;
+        static const common::uint32_t MAX_DELAY = (1u << (LEVELS * SLOT_BITS)) - 1;
+
+        TimerWheel();
+        ~TimerWheel();
+
+        void Add(TimerEntry *entry, common::uint32_t expires);
+        void Cancel(TimerEntry *entry);
+        TimerEntry *Tick();
+        common::uint32_t Now();
+        bool IsEmpty();
+
+    private:
+        TimerEntry *slots[LEVELS][SLOTS];
+        common::uint32_t now; // the next tick to be processed
+        int count;
+
+        void Link(TimerEntry *entry);
+        void Cascade(int level, int index);
+    };
+}
+
+#endif
@@ -0,0 +1,86 @@
+#include <benchmark.h>
+
+using namespace myos;
+using namespace myos::common;
+
+void printf(char *);
+void printfHex32(uint32_t);
+
+Benchmark::Benchmark(char *name)
+{
+    this->name = name;
+    count = 0;
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+/**
+ * @return The time stamp counter of the processor executing the code, in cycles.
+ */
+uint64_t Benchmark::Now()
+{
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a"(low), "=d"(high) : : "memory");
+    return ((uint64_t)high << 32) | low;
+}
+
+/**
+ * Adds a sample, samples beyond MAX_SAMPLES are dropped.
+ *
+ * @param cycles The cycles one run of the operation took.
+ */
+void Benchmark::Record(uint32_t cycles)
+{
+    if (count < MAX_SAMPLES)
+        samples[count++] = cycles;
+}
+
+void Benchmark::Reset()
+{
+    count = 0;
+}
+
+int Benchmark::GetCount()
+{
+    return count;
+}
+
+/**
+ * Sorts the samples and prints one line: name, samples, min, median and 99th percentile in cycles.
+ */
+void Benchmark::Report()
+{
+    printf(name);
+    int length = 0;
+    while (name[length] != '\0')
+        length++;
+    for (int i = length; i < 16; i++)
+        printf(" ");
+
+    printfHex32(count);
+    if (count == 0)
+    {
+        printf("\n");
+        return;
+    }
+
+    // insertion sort, the sample counts are small
+    for (int i = 1; i < count; i++)
+    {
+        uint32_t sample = samples[i];
+        int j = i;
+        for (; j > 0 && samples[j - 1] > sample; j--)
+            samples[j] = samples[j - 1];
+        samples[j] = sample;
+    }
+
+    printf(" ");
+    printfHex32(samples[0]);
+    printf(" ");
+    printfHex32(samples[count / 2]);
+    printf(" ");
+    printfHex32(samples[(count * 99) / 100]);
+    printf("\n");
+}
@@ -0,0 +1,307 @@
+#include <drivers/console.h>
+
+using namespace myos;
+using namespace myos::common;
+using namespace myos::drivers;
+
+Console *Console::activeConsole = 0;
+
+Console::Console()
+    : cursorIndexPort(0x3D4),
+      cursorDataPort(0x3D5)
+{
+    activeConsole = this;
+    videoMemory = (uint16_t *)0xb8000;
+    for (int line = 0; line < SCROLLBACK_LINES; line++)
+        for (int x = 0; x < WIDTH; x++)
+            lines[line][x] = (ATTRIBUTE << 8) | ' ';
+    topLine = 0;
+    history = 0;
+    cursorX = 0;
+    cursorY = 0;
+    viewOffset = 0;
+    // the first write also clears what the boot loader left on the screen
+    dirtyFirst = 0;
+    dirtyLast = HEIGHT - 1;
+    cursorPosition = -1;
+    highlightX = -1;
+    highlightY = -1;
+    serial = 0;
+    screen = true;
+}
+
+Console::~Console()
+{
+    if (activeConsole == this)
+        activeConsole = 0;
+}
+
+/**
+ * Copies whole lines with a single string move.
+ *
+ * @param destination The first cell to write.
+ * @param source The first cell to read.
+ * @param cells The number of cells, a multiple of WIDTH.
+ */
+void Console::Copy(uint16_t *destination, uint16_t *source, int cells)
+{
+    int count = cells / 2;
+    asm volatile("cld; rep movsl" : "+D"(destination), "+S"(source), "+c"(count) : : "memory");
+}
+
+void Console::MarkDirty(int first, int last)
+{
+    if (first < dirtyFirst)
+        dirtyFirst = first;
+    if (last > dirtyLast)
+        dirtyLast = last;
+}
+
+/**
+ * Moves the cursor to the start of the next line. On the last row the top line moves
+ * into the scrollback and the oldest line of the ring becomes the new, empty last row.
+ */
+void Console::NewLine()
+{
+    cursorX = 0;
+    if (cursorY < HEIGHT - 1)
+    {
+        cursorY++;
+        return;
+    }
+
+    topLine = (topLine + 1) % SCROLLBACK_LINES;
+    if (history < SCROLLBACK_LINES - HEIGHT)
+        history++;
+    uint16_t *line = lines[(topLine + HEIGHT - 1) % SCROLLBACK_LINES];
+    for (int x = 0; x < WIDTH; x++)
+        line[x] = (ATTRIBUTE << 8) | ' ';
+    MarkDirty(0, HEIGHT - 1);
+}
+
+/**
+ * Renders a string into the ring, the view returns to the output. The lock must be held.
+ */
+void Console::Render(char *str)
+{
+    if (viewOffset != 0)
+    {
+        viewOffset = 0;
+        MarkDirty(0, HEIGHT - 1);
+    }
+
+    for (int i = 0; str[i] != '\0'; i++)
+    {
+        uint16_t *line = lines[(topLine + cursorY) % SCROLLBACK_LINES];
+        switch (str[i])
+        {
+        case '\n':
+            NewLine();
+            break;
+        case '\b':
+            if (cursorX > 0)
+                cursorX--;
+            line[cursorX] = (ATTRIBUTE << 8) | ' ';
+            MarkDirty(cursorY, cursorY);
+            break;
+        default:
+            line[cursorX] = (ATTRIBUTE << 8) | (uint8_t)str[i];
+            MarkDirty(cursorY, cursorY);
+            if (++cursorX >= WIDTH)
+                NewLine();
+            break;
+        }
+    }
+}
+
+/**
+ * Copies the dirty rows to video memory and moves the hardware cursor. The lock must be held.
+ * The rows of the view are consecutive in the ring unless they wrap around its end,
+ * so this is at most two block moves.
+ */
+void Console::Update()
+{
+    if (dirtyFirst <= dirtyLast)
+    {
+        int row = dirtyFirst;
+        while (row <= dirtyLast)
+        {
+            int line = (topLine - viewOffset + row + SCROLLBACK_LINES) % SCROLLBACK_LINES;
+            int count = dirtyLast - row + 1;
+            if (count > SCROLLBACK_LINES - line)
+                count = SCROLLBACK_LINES - line;
+            Copy(videoMemory + WIDTH * row, lines[line], count * WIDTH);
+            row += count;
+        }
+
+        if (highlightY >= dirtyFirst && highlightY <= dirtyLast)
+        {
+            int line = (topLine - viewOffset + highlightY + SCROLLBACK_LINES) % SCROLLBACK_LINES;
+            uint16_t cell = lines[line][highlightX];
+            videoMemory[WIDTH * highlightY + highlightX] = (cell & 0x0F00) << 4 | (cell & 0xF000) >> 4 | (cell & 0x00FF);
+        }
+
+        dirtyFirst = HEIGHT;
+        dirtyLast = -1;
+    }
+
+    // a position past the screen hides the cursor while the view is scrolled back
+    int position = viewOffset == 0 ? WIDTH * cursorY + cursorX : WIDTH * HEIGHT;
+    if (position != cursorPosition)
+    {
+        cursorIndexPort.Write(0x0F);
+        cursorDataPort.Write(position & 0xFF);
+        cursorIndexPort.Write(0x0E);
+        cursorDataPort.Write((position >> 8) & 0xFF);
+        cursorPosition = position;
+    }
+}
+
+/**
+ * Writes a string to the serial port and the screen right away.
+ */
+void Console::WriteThrough(char *str)
+{
+    SpinlockGuard guard(&lock);
+    if (serial != 0)
+        serial->Write(str);
+    if (!screen)
+        return;
+    Render(str);
+    Update();
+}
+
+/**
+ * Writes a string, the printf of the kernel. A task calling with interrupts on writes into its
+ * line buffer, interrupt handlers, syscalls and the boot code write through.
+ *
+ * @param str The zero-terminated string.
+ */
+void Console::Write(char *str)
+{
+    uint32_t flags;
+    asm volatile("pushf; pop %0" : "=r"(flags));
+    TaskManager *taskManager = TaskManager::activeTaskManager;
+    if ((flags & 0x200) != 0 && taskManager != 0)
+    {
+        // the task cannot change under us, only the task itself appends to its buffer
+        Task *task = taskManager->GetCurrentTask();
+        if (task != 0)
+        {
+            Write(task, str);
+            return;
+        }
+    }
+    WriteThrough(str);
+}
+
+/**
+ * Appends a string to the line buffer of a task, which is written out at every newline
+ * and whenever it is full.
+ *
+ * @param task The task the output belongs to, only ever the calling task.
+ * @param str The zero-terminated string.
+ */
+void Console::Write(Task *task, char *str)
+{
+    for (int i = 0; str[i] != '\0'; i++)
+    {
+        task->output[task->outputLength++] = str[i];
+        if (str[i] == '\n' || task->outputLength == Task::OUTPUT_BUFFER_SIZE)
+            Flush(task);
+    }
+}
+
+/**
+ * Writes out the line buffer of a task, e.g. a prompt before the task reads its answer.
+ *
+ * @param task The task the output belongs to, only ever the calling task.
+ */
+void Console::Flush(Task *task)
+{
+    if (task->outputLength == 0)
+        return;
+    task->output[task->outputLength] = '\0';
+    WriteThrough(task->output);
+    task->outputLength = 0;
+}
+
+/**
+ * Writes out the line buffer of the task running on the calling processor.
+ */
+void Console::Flush()
+{
+    TaskManager *taskManager = TaskManager::activeTaskManager;
+    if (taskManager == 0)
+        return;
+    Task *task = taskManager->GetCurrentTask();
+    if (task != 0)
+        Flush(task);
+}
+
+/**
+ * Writes out the line buffer of the calling task and waits until the serial port has sent everything.
+ */
+void Console::Drain()
+{
+    Flush();
+    SpinlockGuard guard(&lock);
+    if (serial != 0)
+        serial->Drain();
+}
+
+/**
+ * Scrolls the view through the scrollback. New output returns it to the bottom.
+ *
+ * @param lines Lines to scroll back, negative to scroll forward.
+ */
+void Console::ScrollView(int lines)
+{
+    SpinlockGuard guard(&lock);
+    viewOffset += lines;
+    if (viewOffset > history)
+        viewOffset = history;
+    if (viewOffset < 0)
+        viewOffset = 0;
+    MarkDirty(0, HEIGHT - 1);
+    if (screen)
+        Update();
+}
+
+/**
+ * Shows one cell with foreground and background swapped, the text mouse pointer.
+ *
+ * @param x The column, -1 for none.
+ * @param y The row.
+ */
+void Console::SetHighlight(int x, int y)
+{
+    SpinlockGuard guard(&lock);
+    if (highlightX >= 0)
+        MarkDirty(highlightY, highlightY);
+    highlightX = x;
+    highlightY = x >= 0 ? y : -1;
+    if (highlightX >= 0)
+        MarkDirty(highlightY, highlightY);
+    if (screen)
+        Update();
+}
+
+/**
+ * @param serial The port to mirror the output to, 0 for none.
+ */
+void Console::SetSerial(SerialPort *serial)
+{
+    SpinlockGuard guard(&lock);
+    this->serial = serial;
+}
+
+/**
+ * @param screen False to stop writing to the screen, e.g. when the output goes to the serial port only.
+ */
+void Console::SetScreen(bool screen)
+{
+    SpinlockGuard guard(&lock);
+    this->screen = screen;
+    MarkDirty(0, HEIGHT - 1);
+}
@@ -179,9 +179,18 @@ uint32_t KeyboardDriver::HandleInterrupt(uint32_t esp)
         case 0x1C:
             handler->OnKeyDown('\n');
             break;
+        case 0x0E:
+            handler->OnKeyDown('\b');
+            break;
         case 0x39:
             handler->OnKeyDown(' ');
             break;
+        case 0x49:
+            handler->OnKeyDown(KeyboardEventHandler::PAGE_UP);
+            break;
+        case 0x51:
+            handler->OnKeyDown(KeyboardEventHandler::PAGE_DOWN);
+            break;
 
         default:
         {
@@ -0,0 +1,88 @@
+#include <drivers/pit.h>
+
+using namespace myos::common;
+using namespace myos::drivers;
+using namespace myos::hardwarecommunication;
+
+ProgrammableIntervalTimer::ProgrammableIntervalTimer(uint32_t frequency)
+    : channel0port(0x40),
+      commandport(0x43)
+{
+    active = false;
+    SetFrequency(frequency);
+}
+
+ProgrammableIntervalTimer::~ProgrammableIntervalTimer()
+{
+}
+
+/**
+ * Programs channel 0 as a rate generator with the configured divisor.
+ */
+void ProgrammableIntervalTimer::Activate()
+{
+    commandport.Write(0x34); // channel 0, lobyte/hibyte, mode 2 (rate generator)
+    channel0port.Write(divisor & 0xFF);
+    channel0port.Write((divisor >> 8) & 0xFF);
+    active = true;
+}
+
+/**
+ * Sets the rate of the timer interrupt.
+ * The rate is rounded to the nearest divisor of the base frequency,
+ * so the result can be read back with GetFrequency.
+ * Takes effect immediately if the timer was already activated.
+ *
+ * @param frequency The interrupt rate in Hz, from 19 up to BASE_FREQUENCY.
+ */
+void ProgrammableIntervalTimer::SetFrequency(uint32_t frequency)
+{
+    if (frequency == 0)
+        frequency = 1;
+
+    uint32_t d = (BASE_FREQUENCY + frequency / 2) / frequency;
+    if (d < 1)
+        d = 1;
+    if (d > 0xFFFF)
+        d = 0xFFFF;
+
+    divisor = d;
+    this->frequency = (BASE_FREQUENCY + d / 2) / d;
+
+    if (active)
+        Activate();
+}
+
+uint32_t ProgrammableIntervalTimer::GetFrequency()
+{
+    return frequency;
+}
+
+/**
+ * Busy-waits on channel 2 of the timer, which works without interrupts.
+ *
+ * @param microseconds The time to wait.
+ */
+void ProgrammableIntervalTimer::Delay(uint32_t microseconds)
+{
+    Port8Bit channel2port(0x42);
+    Port8Bit commandport(0x43);
+    Port8Bit gateport(0x61); // bit 0 gates channel 2, bit 1 drives the speaker, bit 5 reads its output
+
+    while (microseconds > 0)
+    {
+        uint32_t chunk = microseconds < 50000 ? microseconds : 50000;
+        microseconds -= chunk;
+
+        uint32_t count = chunk * (BASE_FREQUENCY / 1000) / 1000;
+        if (count < 1)
+            count = 1;
+
+        gateport.Write((gateport.Read() & 0xFC) | 0x01);
+        commandport.Write(0xB0); // channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+        channel2port.Write(count & 0xFF);
+        channel2port.Write((count >> 8) & 0xFF);
+        while ((gateport.Read() & 0x20) == 0)
+            ;
+    }
+}
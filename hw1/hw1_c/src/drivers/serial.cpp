@@ -0,0 +1,169 @@
+#include <drivers/serial.h>
+
+using namespace myos;
+using namespace myos::common;
+using namespace myos::drivers;
+using namespace myos::hardwarecommunication;
+
+SerialPort::SerialPort(InterruptManager *manager, KeyboardEventHandler *handler)
+    : InterruptHandler(manager, 0x24),
+      dataport(COM1),
+      interruptEnablePort(COM1 + 1),
+      fifoControlPort(COM1 + 2),
+      lineControlPort(COM1 + 3),
+      modemControlPort(COM1 + 4),
+      lineStatusPort(COM1 + 5)
+{
+    this->handler = handler;
+    bufferStart = 0;
+    bufferLength = 0;
+    transmitting = false;
+    active = false;
+}
+
+SerialPort::~SerialPort()
+{
+}
+
+/**
+ * Programs the UART for 115200 baud, 8N1, with FIFOs and the receive interrupt.
+ * Without a UART at COM1 the port stays inactive and Write does nothing.
+ */
+void SerialPort::Activate()
+{
+    interruptEnablePort.Write(0x00);
+    lineControlPort.Write(0x80); // DLAB, the next two registers are the divisor
+    uint16_t divisor = 115200 / BAUD_RATE;
+    dataport.Write(divisor & 0xFF);
+    interruptEnablePort.Write(divisor >> 8);
+    lineControlPort.Write(0x03);  // 8 data bits, no parity, 1 stop bit
+    fifoControlPort.Write(0xC7);  // enable and clear the FIFOs, receive interrupt at 14 bytes
+    modemControlPort.Write(0x0B); // DTR, RTS and OUT2, which connects the interrupt line
+
+    if (lineStatusPort.Read() == 0xFF)
+        return;
+    interruptEnablePort.Write(0x01); // received data
+    active = true;
+}
+
+/**
+ * Hands buffered characters to the transmitter if its FIFO is empty. The lock must be held.
+ */
+void SerialPort::FillFifo()
+{
+    if ((lineStatusPort.Read() & 0x20) == 0)
+        return;
+    for (int i = 0; i < FIFO_SIZE && bufferLength > 0; i++)
+    {
+        dataport.Write(buffer[bufferStart]);
+        bufferStart = (bufferStart + 1) % BUFFER_SIZE;
+        bufferLength--;
+    }
+}
+
+/**
+ * Appends a character to the buffer. If the buffer is full, the caller feeds the FIFO
+ * itself until there is room again, so no output is lost. The lock must be held.
+ */
+void SerialPort::Put(char c)
+{
+    while (bufferLength == BUFFER_SIZE)
+        FillFifo();
+    buffer[(bufferStart + bufferLength) % BUFFER_SIZE] = c;
+    bufferLength++;
+}
+
+/**
+ * Queues a string for transmission, newlines are sent as CR LF.
+ * Returns without waiting unless the buffer is full.
+ *
+ * @param str The zero-terminated string.
+ */
+void SerialPort::Write(char *str)
+{
+    if (!active)
+        return;
+
+    SpinlockGuard guard(&lock);
+    for (int i = 0; str[i] != '\0'; i++)
+    {
+        if (str[i] == '\n')
+            Put('\r');
+        Put(str[i]);
+    }
+
+    if (!transmitting)
+    {
+        FillFifo();
+        if (bufferLength > 0)
+        {
+            // the transmit interrupt fires once the FIFO is empty and takes over from here
+            transmitting = true;
+            interruptEnablePort.Write(0x03);
+        }
+    }
+}
+
+/**
+ * Waits until everything written so far has left the UART, e.g. before the machine is turned off.
+ */
+void SerialPort::Drain()
+{
+    if (!active)
+        return;
+
+    SpinlockGuard guard(&lock);
+    while (bufferLength > 0)
+        FillFifo();
+    while ((lineStatusPort.Read() & 0x40) == 0)
+        ; // transmitter not empty yet
+}
+
+/**
+ * Refills the transmit FIFO and passes received characters to the handler.
+ * CR is passed on as a newline and DEL as backspace, as terminals send them.
+ */
+uint32_t SerialPort::HandleInterrupt(uint32_t esp)
+{
+    for (int pending = 0; pending < 16; pending++)
+    {
+        uint8_t identification = fifoControlPort.Read();
+        if (identification & 0x01)
+            break; // no interrupt pending
+
+        switch ((identification >> 1) & 0x07)
+        {
+        case 1: // transmitter holding register empty
+        {
+            SpinlockGuard guard(&lock);
+            FillFifo();
+            if (bufferLength == 0)
+            {
+                transmitting = false;
+                interruptEnablePort.Write(0x01);
+            }
+            break;
+        }
+        case 2: // received data
+        case 6: // character timeout
+            // the handler may echo through Write, so the lock is not held here
+            while (lineStatusPort.Read() & 0x01)
+            {
+                char c = dataport.Read();
+                if (c == '\r')
+                    c = '\n';
+                else if (c == 0x7F)
+                    c = '\b';
+                if (handler != 0)
+                    handler->OnKeyDown(c);
+            }
+            break;
+        case 3: // line status, reading it clears the error
+            lineStatusPort.Read();
+            break;
+        default:
+            return esp;
+        }
+    }
+    return esp;
+}
@@ -0,0 +1,140 @@
+#include <drivers/terminal.h>
+#include <drivers/console.h>
+#include <synchronization.h>
+
+using namespace myos;
+using namespace myos::common;
+using namespace myos::drivers;
+
+void printf(char *);
+
+Terminal *Terminal::activeTerminal = 0;
+
+Terminal::Terminal()
+{
+    activeTerminal = this;
+    lineLength = 0;
+    inputStart = 0;
+    inputLength = 0;
+    lines = 0;
+}
+
+Terminal::~Terminal()
+{
+    if (activeTerminal == this)
+        activeTerminal = 0;
+}
+
+/**
+ * Adds a key to the current line, called from the keyboard interrupt.
+ * Enter moves the line to the input queue and wakes the readers. Keys that do not fit
+ * into the line or the input queue are dropped, Enter always ends the line.
+ * Page up and down scroll the console through its scrollback.
+ *
+ * @param c The character of the key.
+ */
+void Terminal::OnKeyDown(char c)
+{
+    if (c == PAGE_UP || c == PAGE_DOWN)
+    {
+        if (Console::activeConsole != 0)
+            Console::activeConsole->ScrollView(c == PAGE_UP ? Console::HEIGHT / 2 : -Console::HEIGHT / 2);
+        return;
+    }
+
+    bool complete = false;
+    {
+        SpinlockGuard guard(&lock);
+        if (c == '\b')
+        {
+            if (lineLength == 0)
+                return;
+            lineLength--;
+        }
+        else if (c == '\n')
+        {
+            line[lineLength++] = c;
+            // as much of the line as fits, the newline last, so the line is complete
+            int length = lineLength < BUFFER_SIZE - inputLength ? lineLength : BUFFER_SIZE - inputLength;
+            if (length > 0)
+            {
+                line[length - 1] = '\n';
+                for (int i = 0; i < length; i++)
+                    input[(inputStart + inputLength + i) % BUFFER_SIZE] = line[i];
+                inputLength += length;
+                lines++;
+                complete = true;
+            }
+            lineLength = 0;
+        }
+        else if (lineLength < BUFFER_SIZE - 1)
+        {
+            line[lineLength++] = c;
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    char *echo = " ";
+    echo[0] = c;
+    printf(echo);
+    if (complete)
+        Futex::Wake(&lines, Futex::ALL);
+}
+
+/**
+ * Takes the first complete line from the input queue without waiting.
+ * A line longer than the buffer is returned in parts, by consecutive reads.
+ *
+ * @param buffer The buffer for the characters, not zero-terminated.
+ * @param size The size of the buffer.
+ * @return The number of characters read, the last is the newline if the line ended.
+ * -1 if no complete line is queued.
+ */
+int Terminal::Read(char *buffer, int size)
+{
+    SpinlockGuard guard(&lock);
+    if (lines == 0)
+        return -1;
+
+    int count = 0;
+    while (count < size)
+    {
+        char c = input[inputStart];
+        inputStart = (inputStart + 1) % BUFFER_SIZE;
+        inputLength--;
+        buffer[count++] = c;
+        if (c == '\n')
+        {
+            lines--;
+            break;
+        }
+    }
+    return count;
+}
+
+/**
+ * The read syscall on the console: returns a line in ecx/edx as Read does,
+ * or blocks the caller until a line is entered and runs the syscall again.
+ *
+ * @param taskManager A pointer to the task manager.
+ * @param cpustate A pointer to the CPU state of the caller.
+ * @return A pointer to the CPU state of the next task.
+ */
+CPUState *Terminal::Read(TaskManager *taskManager, CPUState *cpustate)
+{
+    if ((int)cpustate->edx <= 0)
+    {
+        cpustate->eax = 0;
+        return cpustate;
+    }
+    int count = Read((char *)cpustate->ecx, (int)cpustate->edx);
+    if (count >= 0)
+    {
+        cpustate->eax = count;
+        return cpustate;
+    }
+    return taskManager->WaitAndRestart(cpustate, &lines, 0);
+}
@@ -0,0 +1,134 @@
+#include <fpu.h>
+
+using namespace myos;
+using namespace myos::common;
+using namespace myos::hardwarecommunication;
+
+bool FloatingPointUnit::fxsr = false;
+bool FloatingPointUnit::sse = false;
+
+FloatingPointUnit::FloatingPointUnit(InterruptManager *interruptManager, TaskManager *taskManager)
+    : InterruptHandler(interruptManager, 0x07)
+{
+    this->taskManager = taskManager;
+}
+
+FloatingPointUnit::~FloatingPointUnit()
+{
+}
+
+/**
+ * Handles #NM: the running task used the FPU for the first time since it was switched in.
+ *
+ * @param esp The stack pointer of the CPU state.
+ * @return The same stack pointer, the faulting instruction is executed again.
+ */
+uint32_t FloatingPointUnit::HandleInterrupt(uint32_t esp)
+{
+    taskManager->LoadFloatingPointState();
+    return esp;
+}
+
+/**
+ * Enables the FPU, and SSE if the processor has it, on the processor executing the code.
+ * Must be called on every processor. CR0.TS is left set, so the first use traps.
+ *
+ * @return False if the processor has no FPU.
+ */
+bool FloatingPointUnit::Enable()
+{
+    uint32_t eax, ebx, ecx, edx;
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    if ((edx & 1) == 0)
+        return false;
+    fxsr = (edx & (1 << 24)) != 0;
+    sse = fxsr && (edx & (1 << 25)) != 0;
+
+    uint32_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~(1 << 2);           // EM: no emulation
+    cr0 |= (1 << 1) | (1 << 5); // MP: wait honours TS, NE: errors raise #MF
+    asm volatile("mov %0, %%cr0" : : "r"(cr0));
+
+    if (fxsr)
+    {
+        uint32_t cr4;
+        asm volatile("mov %%cr4, %0" : "=r"(cr4));
+        cr4 |= 1 << 9; // OSFXSR
+        if (sse)
+            cr4 |= 1 << 10; // OSXMMEXCPT
+        asm volatile("mov %0, %%cr4" : : "r"(cr4));
+    }
+
+    ClearTaskSwitched();
+    Initialize();
+    SetTaskSwitched();
+    return true;
+}
+
+/**
+ * Resets the registers to the power-on state for a task using the FPU for the first time.
+ */
+void FloatingPointUnit::Initialize()
+{
+    asm volatile("fninit");
+    if (sse)
+    {
+        uint32_t mxcsr = 0x1F80; // all SSE exceptions masked, round to nearest
+        asm volatile("ldmxcsr %0" : : "m"(mxcsr));
+    }
+}
+
+/**
+ * Saves the registers. They keep their contents, so the task can go on using them.
+ *
+ * @param state A 16-byte aligned area of STATE_SIZE bytes.
+ */
+void FloatingPointUnit::Save(uint8_t *state)
+{
+    if (fxsr)
+    {
+        asm volatile("fxsave (%0)" : : "r"(state) : "memory");
+    }
+    else
+    {
+        // fnsave resets the FPU
+        asm volatile("fnsave (%0); frstor (%0)" : : "r"(state) : "memory");
+    }
+}
+
+/**
+ * Loads the registers from an area filled by Save.
+ *
+ * @param state A 16-byte aligned area of STATE_SIZE bytes.
+ */
+void FloatingPointUnit::Restore(uint8_t *state)
+{
+    if (fxsr)
+        asm volatile("fxrstor (%0)" : : "r"(state) : "memory");
+    else
+        asm volatile("frstor (%0)" : : "r"(state) : "memory");
+}
+
+void FloatingPointUnit::SetTaskSwitched()
+{
+    uint32_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    if ((cr0 & (1 << 3)) == 0)
+        asm volatile("mov %0, %%cr0" : : "r"(cr0 | (1 << 3)));
+}
+
+void FloatingPointUnit::ClearTaskSwitched()
+{
+    asm volatile("clts");
+}
+
+/**
+ * @return True if CR0.TS is set, i.e. the running code has not used the FPU since the last task switch.
+ */
+bool FloatingPointUnit::IsTaskSwitched()
+{
+    uint32_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    return (cr0 & (1 << 3)) != 0;
+}
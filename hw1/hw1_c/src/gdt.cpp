@@ -9,6 +9,14 @@ GlobalDescriptorTable::GlobalDescriptorTable()
         unusedSegmentSelector(0, 0, 0),
         codeSegmentSelector(0, 64*1024*1024, 0x9A),
         dataSegmentSelector(0, 64*1024*1024, 0x92)
+{
+    Load();
+}
+
+/**
+ * Loads the table into the GDTR of the executing processor.
+ */
+void GlobalDescriptorTable::Load()
 {
     uint32_t i[2];
     i[1] = (uint32_t)this;
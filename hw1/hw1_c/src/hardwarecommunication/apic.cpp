@@ -0,0 +1,166 @@
+#include <hardwarecommunication/apic.h>
+#include <drivers/pit.h>
+
+using namespace myos::common;
+using namespace myos::drivers;
+using namespace myos::hardwarecommunication;
+
+// Local APIC register offsets
+#define LAPIC_ID 0x020
+#define LAPIC_EOI 0x0B0
+#define LAPIC_SPURIOUS 0x0F0
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_ICR_HIGH 0x310
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_LVT_LINT0 0x350
+#define LAPIC_LVT_LINT1 0x360
+#define LAPIC_TIMER_INITIAL 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE 0x3E0
+
+#define LVT_MASKED 0x10000
+#define LVT_PERIODIC 0x20000
+
+volatile uint32_t *LocalAPIC::registers = 0;
+
+uint32_t LocalAPIC::Read(uint32_t reg)
+{
+    return registers[reg / 4];
+}
+
+void LocalAPIC::Write(uint32_t reg, uint32_t value)
+{
+    registers[reg / 4] = value;
+}
+
+/**
+ * Enables the local APIC of this processor.
+ * The boot processor keeps taking the 8259 interrupts through LINT0 (virtual wire mode),
+ * the application processors ignore LINT0.
+ *
+ * @param base The physical address of the local APIC registers.
+ * @param bootProcessor True on the boot processor.
+ */
+void LocalAPIC::Enable(uint32_t base, bool bootProcessor)
+{
+    registers = (volatile uint32_t *)base;
+    Write(LAPIC_SPURIOUS, 0x100 | SPURIOUS_VECTOR);
+    Write(LAPIC_LVT_LINT0, bootProcessor ? 0x700 : LVT_MASKED); // ExtINT
+    Write(LAPIC_LVT_LINT1, 0x400);                              // NMI
+    Write(LAPIC_LVT_TIMER, LVT_MASKED);
+}
+
+bool LocalAPIC::IsEnabled()
+{
+    return registers != 0;
+}
+
+uint8_t LocalAPIC::ID()
+{
+    return Read(LAPIC_ID) >> 24;
+}
+
+void LocalAPIC::EndOfInterrupt()
+{
+    Write(LAPIC_EOI, 0);
+}
+
+void LocalAPIC::SendInterProcessorInterrupt(uint8_t apicId, uint32_t command)
+{
+    Write(LAPIC_ICR_HIGH, (uint32_t)apicId << 24);
+    Write(LAPIC_ICR_LOW, command);
+    while (Read(LAPIC_ICR_LOW) & 0x1000) // delivery pending
+        asm volatile("pause");
+}
+
+/**
+ * Sends an INIT IPI, which puts the target processor into the wait-for-SIPI state.
+ *
+ * @param apicId The local APIC ID of the target processor.
+ */
+void LocalAPIC::SendInit(uint8_t apicId)
+{
+    SendInterProcessorInterrupt(apicId, 0x4500); // INIT, level assert
+}
+
+/**
+ * Sends a startup IPI, the target processor starts in real mode at page * 4096.
+ *
+ * @param apicId The local APIC ID of the target processor.
+ * @param page The page number of the startup code, below 1 MiB.
+ */
+void LocalAPIC::SendStartup(uint8_t apicId, uint8_t page)
+{
+    SendInterProcessorInterrupt(apicId, 0x4600 | page);
+}
+
+/**
+ * Measures the local APIC timer against the PIT.
+ * The local APIC timers of all processors run from the same bus clock, so the result holds for all of them.
+ *
+ * @param hz The wanted interrupt rate.
+ * @return The initial count for StartTimer that gives about hz interrupts per second.
+ */
+uint32_t LocalAPIC::CalibrateTimer(uint32_t hz)
+{
+    Write(LAPIC_TIMER_DIVIDE, 0x3); // divide by 16
+    Write(LAPIC_LVT_TIMER, LVT_MASKED);
+    Write(LAPIC_TIMER_INITIAL, 0xFFFFFFFF);
+    ProgrammableIntervalTimer::Delay(10000);
+    uint32_t elapsed = 0xFFFFFFFF - Read(LAPIC_TIMER_CURRENT);
+    Write(LAPIC_TIMER_INITIAL, 0);
+
+    uint32_t count = elapsed * 100 / hz;
+    return count > 0 ? count : 1;
+}
+
+/**
+ * Starts the local APIC timer in periodic mode.
+ *
+ * @param vector The interrupt vector raised on every expiry.
+ * @param initialCount The count from CalibrateTimer.
+ */
+void LocalAPIC::StartTimer(uint8_t vector, uint32_t initialCount)
+{
+    Write(LAPIC_TIMER_DIVIDE, 0x3);
+    Write(LAPIC_LVT_TIMER, LVT_PERIODIC | vector);
+    Write(LAPIC_TIMER_INITIAL, initialCount);
+}
+
+IOAPIC::IOAPIC(uint32_t base)
+{
+    registers = (volatile uint32_t *)base;
+}
+
+IOAPIC::~IOAPIC()
+{
+}
+
+uint32_t IOAPIC::Read(uint8_t reg)
+{
+    registers[0] = reg;  // IOREGSEL
+    return registers[4]; // IOWIN
+}
+
+void IOAPIC::Write(uint8_t reg, uint32_t value)
+{
+    registers[0] = reg;
+    registers[4] = value;
+}
+
+int IOAPIC::GetNumPins()
+{
+    return ((Read(0x01) >> 16) & 0xFF) + 1;
+}
+
+void IOAPIC::Mask(int pin)
+{
+    Write(0x10 + 2 * pin, Read(0x10 + 2 * pin) | LVT_MASKED);
+}
+
+void IOAPIC::MaskAll()
+{
+    int pins = GetNumPins();
+    for (int pin = 0; pin < pins; pin++)
+        Mask(pin);
+}
@@ -1,5 +1,6 @@
 
 #include <hardwarecommunication/interrupts.h>
+#include <hardwarecommunication/apic.h>
 using namespace myos;
 using namespace myos::common;
 using namespace myos::hardwarecommunication;
@@ -28,6 +29,8 @@ uint32_t InterruptHandler::HandleInterrupt(uint32_t esp)
 
 InterruptManager::GateDescriptor InterruptManager::interruptDescriptorTable[256];
 InterruptManager *InterruptManager::ActiveInterruptManager = 0;
+uint32_t InterruptManager::processorStacks[256];
+volatile uint32_t *InterruptManager::apicIdRegister = 0;
 
 void InterruptManager::SetInterruptDescriptorTableEntry(uint8_t interrupt,
                                                         uint16_t CodeSegment, void (*handler)(), uint8_t DescriptorPrivilegeLevel, uint8_t DescriptorType)
@@ -51,6 +54,8 @@ InterruptManager::InterruptManager(uint16_t hardwareInterruptOffset, GlobalDescr
 {
     this->taskManager = taskManager;
     this->hardwareInterruptOffset = hardwareInterruptOffset;
+    tickless = false;
+    timerMasked = false;
     uint32_t CodeSegment = globalDescriptorTable->CodeSegmentSelector();
 
     const uint8_t IDT_INTERRUPT_GATE = 0xE;
@@ -99,6 +104,7 @@ InterruptManager::InterruptManager(uint16_t hardwareInterruptOffset, GlobalDescr
     SetInterruptDescriptorTableEntry(hardwareInterruptOffset + 0x0D, CodeSegment, &HandleInterruptRequest0x0D, 0, IDT_INTERRUPT_GATE);
     SetInterruptDescriptorTableEntry(hardwareInterruptOffset + 0x0E, CodeSegment, &HandleInterruptRequest0x0E, 0, IDT_INTERRUPT_GATE);
     SetInterruptDescriptorTableEntry(hardwareInterruptOffset + 0x0F, CodeSegment, &HandleInterruptRequest0x0F, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(hardwareInterruptOffset + LOCAL_TIMER_IRQ, CodeSegment, &HandleInterruptRequest0x20, 0, IDT_INTERRUPT_GATE);
 
     SetInterruptDescriptorTableEntry(0x80, CodeSegment, &HandleInterruptRequest0x80, 0, IDT_INTERRUPT_GATE);
 
@@ -143,6 +149,71 @@ void InterruptManager::Activate()
     asm("sti");
 }
 
+/**
+ * Loads the interrupt descriptor table on an application processor and enables its interrupts
+ * as soon as the boot processor has activated this interrupt manager.
+ */
+void InterruptManager::ActivateProcessor()
+{
+    InterruptDescriptorTablePointer idt_pointer;
+    idt_pointer.size = 256 * sizeof(GateDescriptor) - 1;
+    idt_pointer.base = (uint32_t)interruptDescriptorTable;
+    asm volatile("lidt %0" : : "m"(idt_pointer));
+
+    while (ActiveInterruptManager != this)
+        asm volatile("pause" : : : "memory");
+    asm("sti");
+}
+
+/**
+ * Gives a processor its own stack for running interrupt handlers.
+ *
+ * @param apicId The local APIC ID of the processor.
+ * @param esp The top of the stack.
+ */
+void InterruptManager::SetProcessorStack(uint8_t apicId, uint32_t esp)
+{
+    processorStacks[apicId] = esp;
+}
+
+/**
+ * Makes every processor with a stack from SetProcessorStack run its interrupt handlers on it.
+ * The interrupted CPU state stays on the task's stack, but the handler no longer uses it,
+ * so another processor may resume the task while the handler is still returning.
+ *
+ * @param localApicAddress The physical address of the local APIC registers.
+ */
+void InterruptManager::EnableProcessorStacks(uint32_t localApicAddress)
+{
+    apicIdRegister = (volatile uint32_t *)(localApicAddress + 0x20);
+}
+
+/**
+ * Enables or disables tickless idle.
+ * When enabled, the timer interrupt is masked while the idle task runs
+ * and unmasked again as soon as another interrupt makes a task ready.
+ *
+ * @param tickless True to stop the clock while idle.
+ */
+void InterruptManager::SetTickless(bool tickless)
+{
+    this->tickless = tickless;
+    if (!tickless)
+        SetTimerMasked(false);
+}
+
+void InterruptManager::SetTimerMasked(bool masked)
+{
+    if (masked == timerMasked)
+        return;
+    timerMasked = masked;
+    uint8_t mask = programmableInterruptControllerMasterDataPort.Read();
+    if (masked)
+        programmableInterruptControllerMasterDataPort.Write(mask | 0x01);
+    else
+        programmableInterruptControllerMasterDataPort.Write(mask & ~0x01);
+}
+
 void InterruptManager::Deactivate()
 {
     if (ActiveInterruptManager == this)
@@ -171,13 +242,29 @@ uint32_t InterruptManager::DoHandleInterrupt(uint8_t interrupt, uint32_t esp)
         // printfHex(interrupt);
     }
 
-    if (interrupt == hardwareInterruptOffset)
+    // the PIT drives the boot processor, the local APIC timer the application processors
+    bool localTimer = interrupt == hardwareInterruptOffset + LOCAL_TIMER_IRQ;
+    if (interrupt == hardwareInterruptOffset || localTimer)
     {
         esp = (uint32_t)taskManager->Schedule((CPUState *)esp);
     }
+    else if (timerMasked && taskManager->HasReadyTask())
+    {
+        // the interrupted context is the idle task, switch to the woken task right away
+        esp = (uint32_t)taskManager->Yield((CPUState *)esp);
+    }
+
+    // without a ready task there is nothing to preempt, and without a sleeping task nothing to wake,
+    // so the clock can stay quiet
+    if (tickless)
+        SetTimerMasked(taskManager->IsIdle() && !taskManager->HasTimers());
 
     // hardware interrupts must be acknowledged
-    if (hardwareInterruptOffset <= interrupt && interrupt < hardwareInterruptOffset + 16)
+    if (localTimer)
+    {
+        LocalAPIC::EndOfInterrupt();
+    }
+    else if (hardwareInterruptOffset <= interrupt && interrupt < hardwareInterruptOffset + 16)
     {
         programmableInterruptControllerMasterCommandPort.Write(0x20);
         if (hardwareInterruptOffset + 8 <= interrupt)
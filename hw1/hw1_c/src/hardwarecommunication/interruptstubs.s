@@ -7,10 +7,24 @@
 .extern _ZN4myos21hardwarecommunication16InterruptManager15HandleInterruptEhj
 
 
+.extern _ZN4myos21hardwarecommunication16InterruptManager15processorStacksE
+.extern _ZN4myos21hardwarecommunication16InterruptManager14apicIdRegisterE
+
+# every stub leaves the error code (0 if the CPU pushes none) and the interrupt number on the stack
+
 .macro HandleException num
 .global _ZN4myos21hardwarecommunication16InterruptManager19HandleException\num\()Ev
 _ZN4myos21hardwarecommunication16InterruptManager19HandleException\num\()Ev:
-    movb $\num, (interruptnumber)
+    pushl $0
+    pushl $\num
+    jmp int_bottom
+.endm
+
+
+.macro HandleExceptionWithErrorCode num
+.global _ZN4myos21hardwarecommunication16InterruptManager19HandleException\num\()Ev
+_ZN4myos21hardwarecommunication16InterruptManager19HandleException\num\()Ev:
+    pushl $\num
     jmp int_bottom
 .endm
 
@@ -18,8 +32,8 @@ _ZN4myos21hardwarecommunication16InterruptManager19HandleException\num\()Ev:
 .macro HandleInterruptRequest num
 .global _ZN4myos21hardwarecommunication16InterruptManager26HandleInterruptRequest\num\()Ev
 _ZN4myos21hardwarecommunication16InterruptManager26HandleInterruptRequest\num\()Ev:
-    movb $\num + IRQ_BASE, (interruptnumber)
     pushl $0
+    pushl $\num + IRQ_BASE
     jmp int_bottom
 .endm
 
@@ -32,16 +46,16 @@ HandleException 0x04
 HandleException 0x05
 HandleException 0x06
 HandleException 0x07
-HandleException 0x08
+HandleExceptionWithErrorCode 0x08
 HandleException 0x09
-HandleException 0x0A
-HandleException 0x0B
-HandleException 0x0C
-HandleException 0x0D
-HandleException 0x0E
+HandleExceptionWithErrorCode 0x0A
+HandleExceptionWithErrorCode 0x0B
+HandleExceptionWithErrorCode 0x0C
+HandleExceptionWithErrorCode 0x0D
+HandleExceptionWithErrorCode 0x0E
 HandleException 0x0F
 HandleException 0x10
-HandleException 0x11
+HandleExceptionWithErrorCode 0x11
 HandleException 0x12
 HandleException 0x13
 
@@ -61,6 +75,7 @@ HandleInterruptRequest 0x0C
 HandleInterruptRequest 0x0D
 HandleInterruptRequest 0x0E
 HandleInterruptRequest 0x0F
+HandleInterruptRequest 0x20
 HandleInterruptRequest 0x31
 
 HandleInterruptRequest 0x80
@@ -90,9 +105,23 @@ int_bottom:
     #mov %eax, %eds
     #mov %eax, %ees
 
+    # run the C++ handler on the interrupt stack of this processor, if it has one,
+    # so the interrupted task can be resumed elsewhere as soon as the scheduler lets go of it
+    movl %esp, %ebp
+    movl (_ZN4myos21hardwarecommunication16InterruptManager14apicIdRegisterE), %eax
+    testl %eax, %eax
+    jz 1f
+    movl (%eax), %eax
+    shrl $24, %eax
+    movl _ZN4myos21hardwarecommunication16InterruptManager15processorStacksE(,%eax,4), %eax
+    testl %eax, %eax
+    jz 1f
+    movl %eax, %esp
+1:
+
     # call C++ Handler
-    pushl %esp
-    push (interruptnumber)
+    pushl %ebp
+    pushl 28(%ebp) # interrupt number
     call _ZN4myos21hardwarecommunication16InterruptManager15HandleInterruptEhj
     #add %esp, 6
     mov %eax, %esp # switch the stack
@@ -112,7 +141,7 @@ int_bottom:
     #pop %ds
     #popa
     
-    add $4, %esp
+    add $8, %esp # interrupt number and error code
 
 .global _ZN4myos21hardwarecommunication16InterruptManager15InterruptIgnoreEv
 _ZN4myos21hardwarecommunication16InterruptManager15InterruptIgnoreEv:
@@ -120,5 +149,4 @@ _ZN4myos21hardwarecommunication16InterruptManager15InterruptIgnoreEv:
     iret
 
 
-.data
-    interruptnumber: .byte 0
+.section .note.GNU-stack,"",@progbits
@@ -0,0 +1,877 @@
+// Benchmarks and checks of the core subsystems as a Linux program, built with make hostbench.
+// Every sample is the average cycle count of one operation over a batch of BATCH_SIZE operations.
+// A failed check is printed and makes the program exit with 1.
+
+#include <common/types.h>
+#include <benchmark.h>
+#include <memorymanagement.h>
+#include <pageframe.h>
+#include <slab.h>
+#include <multitasking.h>
+#include <scheduler.h>
+#include <queue.h>
+#include <rng.h>
+#include <hardwarecommunication/interrupts.h>
+#include <hardwarecommunication/pci.h>
+#include <drivers/amd_am79c973.h>
+#include <net/etherframe.h>
+#include <net/arp.h>
+#include <net/ipv4.h>
+#include <net/tcp.h>
+
+using namespace myos;
+using namespace myos::common;
+using namespace myos::drivers;
+using namespace myos::hardwarecommunication;
+using namespace myos::net;
+
+void printf(char *);
+
+static const int BATCHES = Benchmark::MAX_SAMPLES;
+static const int HEAP_SIZE = 16 * 1024 * 1024;
+static const int LIVE_BLOCKS = 256;    // allocations held at once by the malloc benchmark
+static const int NUM_TASKS = 32;       // READY tasks in the scheduler benchmarks
+static const int PACKET_SIZE = 1500;
+static const int SEGMENT_SIZE = 512;   // payload of the TCP segments
+static const int RAM_PAGES = 1024;     // memory handed to the page frame allocator by the checks
+
+static const uint32_t LOCAL_IP = 0x0F02000A;  // 10.0.2.15, as in kernelMain
+static const uint32_t REMOTE_IP = 0x0202000A; // 10.0.2.2
+static const uint32_t SUBNET_MASK = 0x00FFFFFF;
+
+uint8_t heap[HEAP_SIZE];
+uint8_t ram[RAM_PAGES * PageFrameAllocator::PAGE_SIZE + PageFrameAllocator::PAGE_SIZE]; // physical memory of the checks
+RandomNumberGenerator rng(1, 2);
+int failures = 0;
+
+/**
+ * Counts a check, printing it if it failed.
+ *
+ * @param passed The outcome of the check.
+ * @param name What was checked.
+ */
+void check(bool passed, char *name)
+{
+    if (passed)
+        return;
+    printf("FAILED: ");
+    printf(name);
+    printf("\n");
+    failures++;
+}
+
+static uint32_t toBigEndian32(uint32_t x)
+{
+    return ((x & 0xFF000000) >> 24) | ((x & 0x00FF0000) >> 8) | ((x & 0x0000FF00) << 8) | ((x & 0x000000FF) << 24);
+}
+
+static uint16_t toBigEndian16(uint16_t x)
+{
+    return ((x & 0xFF00) >> 8) | ((x & 0x00FF) << 8);
+}
+
+/**
+ * Frees and allocates blocks of 16 to 2048 bytes at random among LIVE_BLOCKS live ones,
+ * so the heap stays fragmented like in a running kernel.
+ */
+void benchmarkMalloc()
+{
+    static const int BATCH_SIZE = 1024;
+    Benchmark benchmark("malloc+free");
+    void *blocks[LIVE_BLOCKS];
+    for (int i = 0; i < LIVE_BLOCKS; i++)
+        blocks[i] = MemoryManager::activeMemoryManager->malloc(16 << ((uint32_t)rng.NextInt() % 8));
+
+    for (int batch = 0; batch < BATCHES; batch++)
+    {
+        uint64_t start = Benchmark::Now();
+        for (int i = 0; i < BATCH_SIZE; i++)
+        {
+            uint32_t random = rng.NextInt();
+            int slot = (random >> 8) % LIVE_BLOCKS;
+            MemoryManager::activeMemoryManager->free(blocks[slot]);
+            blocks[slot] = MemoryManager::activeMemoryManager->malloc(16 << (random % 8));
+        }
+        benchmark.Record((uint32_t)(Benchmark::Now() - start) / BATCH_SIZE);
+    }
+
+    for (int i = 0; i < LIVE_BLOCKS; i++)
+        MemoryManager::activeMemoryManager->free(blocks[i]);
+    benchmark.Report();
+}
+
+/**
+ * Frees and allocates packet-sized objects at random among LIVE_BLOCKS live ones of one cache.
+ */
+void benchmarkSlab()
+{
+    static const int BATCH_SIZE = 1024;
+    Benchmark benchmark("slab alloc+free");
+    SlabCache cache("benchmark", PACKET_SIZE);
+    void *objects[LIVE_BLOCKS];
+    for (int i = 0; i < LIVE_BLOCKS; i++)
+        objects[i] = cache.Allocate();
+
+    for (int batch = 0; batch < BATCHES; batch++)
+    {
+        uint64_t start = Benchmark::Now();
+        for (int i = 0; i < BATCH_SIZE; i++)
+        {
+            int slot = ((uint32_t)rng.NextInt() >> 8) % LIVE_BLOCKS;
+            cache.Free(objects[slot]);
+            objects[slot] = cache.Allocate();
+        }
+        benchmark.Record((uint32_t)(Benchmark::Now() - start) / BATCH_SIZE);
+    }
+
+    for (int i = 0; i < LIVE_BLOCKS; i++)
+        cache.Free(objects[i]);
+    benchmark.Report();
+}
+
+/**
+ * Allocates BATCH_SIZE objects of 16 to 128 bytes from the arena of a task and releases the arena,
+ * as a short-lived task does, per allocation.
+ */
+void benchmarkArena()
+{
+    static const int BATCH_SIZE = 1024;
+    Benchmark benchmark("task_alloc");
+    CPUState initial;
+    Task *task = new Task((uint32_t)&initial);
+
+    for (int batch = 0; batch < BATCHES; batch++)
+    {
+        uint64_t start = Benchmark::Now();
+        for (int i = 0; i < BATCH_SIZE; i++)
+            task->Allocate(16 << ((uint32_t)rng.NextInt() % 4));
+        task->ReleaseArena();
+        benchmark.Record((uint32_t)(Benchmark::Now() - start) / BATCH_SIZE);
+    }
+
+    delete task;
+    benchmark.Report();
+}
+
+/**
+ * Fills the queue with random priorities and empties it again, per enqueue and dequeue pair.
+ */
+void benchmarkPriorityQueue()
+{
+    Benchmark benchmark("priority queue");
+    PriorityQueue queue;
+
+    for (int batch = 0; batch < BATCHES; batch++)
+    {
+        uint64_t start = Benchmark::Now();
+        for (int i = 0; i < PriorityQueue::CAPACITY; i++)
+            queue.enqueue(i, (uint32_t)rng.NextInt() % 64);
+        while (!queue.isEmpty())
+            queue.dequeue();
+        benchmark.Record((uint32_t)(Benchmark::Now() - start) / PriorityQueue::CAPACITY);
+    }
+    benchmark.Report();
+}
+
+/**
+ * @return The first page of ram.
+ */
+uint8_t *ramBase()
+{
+    return (uint8_t *)(((uint32_t)ram + PageFrameAllocator::PAGE_SIZE - 1) & ~(PageFrameAllocator::PAGE_SIZE - 1));
+}
+
+// An entry of the multiboot memory map, as the boot loader passes it
+struct MemoryMapEntry
+{
+    uint32_t size;
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+} __attribute__((packed));
+
+/**
+ * Allocates a page block, marks its pages in a map of ram and fills it.
+ *
+ * @return false if the block is misaligned, outside ram or overlaps a block in the map.
+ */
+bool allocatePageBlock(PageFrameAllocator *allocator, uint8_t *used, uint8_t *base, void *&block, int order)
+{
+    block = allocator->AllocatePages(order);
+    if (block == 0)
+        return true;
+    uint32_t page = ((uint8_t *)block - base) / PageFrameAllocator::PAGE_SIZE;
+    if (((uint32_t)block >> PageFrameAllocator::PAGE_SHIFT) % (1u << order) != 0 || (uint8_t *)block < base ||
+        page + (1u << order) > RAM_PAGES)
+        return false;
+    for (uint32_t i = page; i < page + (1u << order); i++)
+    {
+        if (used[i] != 0)
+            return false;
+        used[i] = 1;
+    }
+    for (uint32_t i = 0; i < PageFrameAllocator::PAGE_SIZE << order; i++)
+        ((uint8_t *)block)[i] = 0xAA;
+    return true;
+}
+
+/**
+ * Builds a page frame allocator on ram from a memory map with a reserved hole, with the kernel
+ * and the command line inside the RAM. Every page handed out must be free RAM, aligned to its block
+ * and not handed out twice, and after random allocations and frees every frame must be back.
+ */
+void checkPageFrames()
+{
+    static const int LIVE_BLOCKS = 32;
+    uint8_t *base = ramBase();
+    uint8_t *kernelEnd = base + 5 * PageFrameAllocator::PAGE_SIZE + 7;
+    uint8_t *holeStart = base + 128 * PageFrameAllocator::PAGE_SIZE;
+    uint8_t *holeEnd = base + 144 * PageFrameAllocator::PAGE_SIZE;
+    char *cmdline = (char *)base + 200 * PageFrameAllocator::PAGE_SIZE + 10;
+    char *text = "sched=stride";
+    for (int i = 0; i <= 12; i++)
+        cmdline[i] = text[i];
+
+    MemoryMapEntry map[3];
+    uint8_t *bounds[3][2] = { { base, holeStart }, { holeStart, holeEnd }, { holeEnd, base + RAM_PAGES * PageFrameAllocator::PAGE_SIZE } };
+    for (int i = 0; i < 3; i++)
+    {
+        map[i].size = sizeof(MemoryMapEntry) - sizeof(map[i].size);
+        map[i].base = (uint32_t)bounds[i][0];
+        map[i].length = bounds[i][1] - bounds[i][0];
+        map[i].type = i == 1 ? 2 : 1;
+    }
+    uint32_t multiboot[22];
+    multiboot[0] = (1 << 6) | (1 << 2);
+    multiboot[4] = (uint32_t)cmdline;
+    multiboot[11] = sizeof(map);
+    multiboot[12] = (uint32_t)map;
+
+    PageFrameAllocator allocator(multiboot, (size_t)kernelEnd);
+    check(allocator.TotalFrames() > 0 && allocator.FreeFrames() == allocator.TotalFrames(), "page frames are free at first");
+    int largest = PageFrameAllocator::MAX_ORDER;
+    void *block = allocator.AllocatePages(largest);
+    while (block == 0 && largest > 0)
+        block = allocator.AllocatePages(--largest);
+    allocator.FreePages(block, largest);
+
+    // every single page, none of them reserved
+    uint8_t used[RAM_PAGES];
+    for (int i = 0; i < RAM_PAGES; i++)
+        used[i] = 0;
+    uint32_t pages = 0;
+    bool valid = true;
+    void *page;
+    while (valid && (valid = allocatePageBlock(&allocator, used, base, page, 0)) && page != 0)
+    {
+        uint8_t *address = (uint8_t *)page;
+        valid = address >= kernelEnd && (address >= holeEnd || address + PageFrameAllocator::PAGE_SIZE <= holeStart) &&
+                ((char *)address > cmdline || (char *)address + PageFrameAllocator::PAGE_SIZE <= cmdline);
+        pages++;
+    }
+    check(valid, "page frames are aligned, distinct and outside reserved memory");
+    check(pages == allocator.TotalFrames() && allocator.FreeFrames() == 0, "every page frame can be allocated");
+    check(cmdline[0] == 's' && cmdline[12] == '\0', "page frames keep the command line");
+    for (int i = 0; i < RAM_PAGES; i++)
+        if (used[i] != 0)
+        {
+            allocator.FreePages(base + i * PageFrameAllocator::PAGE_SIZE, 0);
+            used[i] = 0;
+        }
+    check(allocator.FreeFrames() == allocator.TotalFrames(), "page frames are all freed");
+
+    // blocks of mixed orders at random
+    void *blocks[LIVE_BLOCKS];
+    int orders[LIVE_BLOCKS];
+    for (int i = 0; i < LIVE_BLOCKS; i++)
+        blocks[i] = 0;
+    valid = true;
+    for (int i = 0; i < 4096 && valid; i++)
+    {
+        int slot = (uint32_t)rng.NextInt() % LIVE_BLOCKS;
+        if (blocks[slot] != 0)
+        {
+            uint32_t first = ((uint8_t *)blocks[slot] - base) / PageFrameAllocator::PAGE_SIZE;
+            for (uint32_t j = first; j < first + (1u << orders[slot]); j++)
+                used[j] = 0;
+            allocator.FreePages(blocks[slot], orders[slot]);
+        }
+        orders[slot] = (uint32_t)rng.NextInt() % 5;
+        valid = allocatePageBlock(&allocator, used, base, blocks[slot], orders[slot]);
+    }
+    check(valid, "page blocks are aligned to their size and do not overlap");
+    for (int i = 0; i < LIVE_BLOCKS; i++)
+        allocator.FreePages(blocks[i], orders[i]);
+    check(allocator.FreeFrames() == allocator.TotalFrames(), "page blocks return every frame");
+
+    check(allocator.AllocatePages(largest) != 0, "freed page blocks merge with their buddies");
+}
+
+/**
+ * Allocates blocks of 1 to 4096 bytes at random, frees every other one and allocates again:
+ * every block is aligned, keeps its contents and overlaps no other live block.
+ */
+void checkMalloc()
+{
+    static const int BLOCKS = 128;
+    uint8_t *blocks[BLOCKS];
+    uint32_t sizes[BLOCKS];
+    for (int round = 0; round < 2; round++)
+        for (int i = 0; i < BLOCKS; i++)
+        {
+            if (round == 1 && i % 2 == 0)
+                continue;
+            if (round == 1)
+                MemoryManager::activeMemoryManager->free(blocks[i]);
+            sizes[i] = 1 + (uint32_t)rng.NextInt() % 4096;
+            blocks[i] = (uint8_t *)MemoryManager::activeMemoryManager->malloc(sizes[i]);
+            check(blocks[i] != 0, "malloc returns memory");
+            check((uint32_t)blocks[i] % MemoryManager::ALIGNMENT == 0, "malloc aligns blocks");
+            for (uint32_t j = 0; j < sizes[i]; j++)
+                blocks[i][j] = i;
+        }
+
+    for (int i = 0; i < BLOCKS; i++)
+    {
+        bool intact = true;
+        for (uint32_t j = 0; j < sizes[i]; j++)
+            intact = intact && blocks[i][j] == i;
+        check(intact, "malloc blocks keep their contents");
+        for (int j = 0; j < i; j++)
+            check(blocks[i] + sizes[i] <= blocks[j] || blocks[j] + sizes[j] <= blocks[i], "malloc blocks do not overlap");
+    }
+
+    for (int i = 0; i < BLOCKS; i++)
+        MemoryManager::activeMemoryManager->free(blocks[i]);
+}
+
+// Gives the checks access to the size classes of the heap
+class MemoryManagerProbe : public MemoryManager
+{
+public:
+    MemoryManagerProbe(size_t start, size_t size)
+        : MemoryManager(start, size)
+    {
+    }
+
+    static bool MapsTo(size_t size, int firstLevel, int secondLevel)
+    {
+        int first, second;
+        Mapping(size, &first, &second);
+        return first == firstLevel && second == secondLevel;
+    }
+};
+
+/**
+ * Checks the TLSF heap on a private region of exactly one size class, 32 KiB:
+ * the size classes at first and second level boundaries, splitting and coalescing,
+ * exhaustion, and growing from a page frame allocator on ram.
+ */
+void checkTlsf()
+{
+    static const size_t REGION_SIZE = 32 * 1024;
+    static uint64_t region[(REGION_SIZE + sizeof(MemoryChunk)) / sizeof(uint64_t)];
+    MemoryManager *active = MemoryManager::activeMemoryManager;
+
+    // sizes up to the next power of two are split into eight classes
+    check(MemoryManagerProbe::MapsTo(8, 3, 0) && MemoryManagerProbe::MapsTo(15, 3, 7), "tlsf maps the smallest sizes exactly");
+    check(MemoryManagerProbe::MapsTo(255, 7, 7) && MemoryManagerProbe::MapsTo(256, 8, 0), "tlsf maps sizes at a first level boundary");
+    check(MemoryManagerProbe::MapsTo(287, 8, 0) && MemoryManagerProbe::MapsTo(288, 8, 1), "tlsf maps sizes at a second level boundary");
+    check(MemoryManagerProbe::MapsTo(0x80000000, 31, 0), "tlsf maps the largest size");
+
+    MemoryManagerProbe heap((size_t)region, sizeof(region));
+    void *all = heap.malloc(REGION_SIZE);
+    check(all != 0, "tlsf hands out the whole region");
+    check(heap.malloc(1) == 0, "tlsf returns 0 once exhausted");
+    check(heap.malloc(0x80000001) == 0, "tlsf refuses sizes beyond 2 GiB");
+    heap.free(all);
+
+    // a freed chunk at the bottom of its class fits every size rounded up to it, and only those
+    static const size_t boundaries[] = { 64, 256, 288, 1024, 1152 };
+    for (int i = 0; i < sizeof(boundaries) / sizeof(boundaries[0]); i++)
+    {
+        void *block = heap.malloc(boundaries[i]);
+        void *guard = heap.malloc(1); // keeps the block from merging with the rest of the region
+        heap.free(block);
+        void *same = heap.malloc(boundaries[i] - 7);
+        check(same == block, "tlsf reuses a chunk for sizes rounded up to its class");
+        heap.free(same);
+        void *larger = heap.malloc(boundaries[i] + 1);
+        check(larger != block, "tlsf takes larger sizes from the next class");
+        heap.free(larger);
+        heap.free(guard);
+    }
+
+    // a chunk inside a class is never handed out for a larger size of the same class
+    void *small = heap.malloc(296);
+    void *guard = heap.malloc(1);
+    heap.free(small);
+    void *large = heap.malloc(312);
+    check(large != small && ((MemoryChunk *)large - 1)->size >= 312, "tlsf rounds sizes up to the next class");
+    heap.free(large);
+    heap.free(guard);
+
+    // three neighbours split from the region and merged back, freed middle last
+    uint8_t *blocks[3];
+    for (int i = 0; i < 3; i++)
+        blocks[i] = (uint8_t *)heap.malloc(100);
+    check(((MemoryChunk *)blocks[0] - 1)->size == 104, "tlsf splits chunks to the rounded size");
+    check(blocks[1] == blocks[0] + 104 + sizeof(MemoryChunk) && blocks[2] == blocks[1] + 104 + sizeof(MemoryChunk),
+          "tlsf splits neighbouring chunks off the front");
+    heap.free(blocks[0]);
+    heap.free(blocks[2]);
+    heap.free(blocks[1]);
+    check(heap.malloc(REGION_SIZE) == all, "tlsf coalesces freed neighbours");
+
+    // grows by a region from the page frame allocator, until that runs out
+    uint8_t *base = ramBase();
+    MemoryMapEntry map;
+    map.size = sizeof(MemoryMapEntry) - sizeof(map.size);
+    map.base = (uint32_t)base;
+    map.length = RAM_PAGES * PageFrameAllocator::PAGE_SIZE;
+    map.type = 1;
+    uint32_t multiboot[22];
+    multiboot[0] = 1 << 6;
+    multiboot[11] = sizeof(map);
+    multiboot[12] = (uint32_t)&map;
+    PageFrameAllocator allocator(multiboot, (size_t)base);
+    uint32_t freeFrames = allocator.FreeFrames();
+    uint8_t *grown = (uint8_t *)heap.malloc(64 * 1024);
+    check(grown >= base && grown < base + RAM_PAGES * PageFrameAllocator::PAGE_SIZE, "tlsf grows from the page frame allocator");
+    check(allocator.FreeFrames() == freeFrames - (MemoryManager::GROWTH >> PageFrameAllocator::PAGE_SHIFT), "tlsf grows by GROWTH");
+    check(heap.malloc(64 * 1024) != 0, "tlsf allocates from a grown region");
+    check(heap.malloc(RAM_PAGES * PageFrameAllocator::PAGE_SIZE) == 0, "tlsf returns 0 once the page frames run out");
+
+    MemoryManager::activeMemoryManager = active;
+}
+
+/**
+ * Arena allocations of a task are aligned and distinct, and sizes beyond 2 GiB are refused.
+ */
+void checkArena()
+{
+    CPUState initial;
+    Task *task = new Task((uint32_t)&initial);
+    uint8_t *previous = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        uint32_t size = 1 + (uint32_t)rng.NextInt() % 1024;
+        uint8_t *memory = (uint8_t *)task->Allocate(size);
+        check(memory != 0 && (uint32_t)memory % MemoryManager::ALIGNMENT == 0, "task_alloc aligns memory");
+        check(memory != previous, "task_alloc hands out distinct memory");
+        for (uint32_t j = 0; j < size; j++)
+            memory[j] = 0xAA;
+        previous = memory;
+    }
+    check(task->Allocate(0xFFFFFFF9) == 0, "task_alloc refuses sizes that wrap around");
+    check(task->Allocate(0x80000001) == 0, "task_alloc refuses sizes beyond 2 GiB");
+    delete task;
+}
+
+/**
+ * Without a heap the task cache cannot grow: once its free objects are used up, new Task returns 0
+ * instead of running the constructor on a null pointer.
+ */
+void checkTaskExhaustion()
+{
+    static const int MAX_TASKS = 64;
+    CPUState initial;
+    Task *tasks[MAX_TASKS];
+    MemoryManager *active = MemoryManager::activeMemoryManager;
+    MemoryManager::activeMemoryManager = 0;
+    int count = 0;
+    while (count < MAX_TASKS && (tasks[count] = new Task((uint32_t)&initial)) != 0)
+        count++;
+    MemoryManager::activeMemoryManager = active;
+
+    check(count < MAX_TASKS, "new Task returns 0 when the task cache cannot grow");
+    for (int i = 0; i < count; i++)
+        delete tasks[i];
+}
+
+/**
+ * The objects of a slab cache are distinct and come back once freed.
+ */
+void checkSlab()
+{
+    static const int OBJECTS = 64;
+    SlabCache cache("check", 100);
+    void *objects[OBJECTS];
+    for (int i = 0; i < OBJECTS; i++)
+    {
+        objects[i] = cache.Allocate();
+        check(objects[i] != 0, "slab allocates objects");
+        for (int j = 0; j < i; j++)
+            check(objects[i] != objects[j], "slab objects are distinct");
+    }
+    cache.Free(objects[5]);
+    check(cache.Allocate() == objects[5], "slab reuses freed objects");
+    for (int i = 0; i < OBJECTS; i++)
+        cache.Free(objects[i]);
+}
+
+/**
+ * Round-robin picks in FIFO order, the priority policy the highest priority first and FIFO
+ * among equal priorities.
+ */
+void checkPickOrder()
+{
+    static const int COUNT = 4;
+    static const int priorities[COUNT] = { 1, 5, 3, 5 };
+    static const int priorityOrder[COUNT] = { 1, 3, 2, 0 };
+    CPUState initial;
+    Task *tasks[COUNT];
+    for (int i = 0; i < COUNT; i++)
+    {
+        tasks[i] = new Task((uint32_t)&initial);
+        tasks[i]->SetPriority(priorities[i]);
+    }
+
+    RoundRobinPolicy roundRobin;
+    for (int i = 0; i < COUNT; i++)
+        roundRobin.Enqueue(tasks[i]);
+    for (int i = 0; i < COUNT; i++)
+        check(roundRobin.Dequeue() == tasks[i], "round-robin picks in FIFO order");
+    check(roundRobin.Dequeue() == 0, "round-robin runs empty");
+
+    PriorityPolicy priority;
+    priority.UsePriorities(true);
+    for (int i = 0; i < COUNT; i++)
+        priority.Enqueue(tasks[i]);
+    for (int i = 0; i < COUNT; i++)
+        check(priority.Dequeue() == tasks[priorityOrder[i]], "priority policy picks the highest priority first");
+    check(priority.Dequeue() == 0, "priority policy runs empty");
+
+    for (int i = 0; i < COUNT; i++)
+        delete tasks[i];
+}
+
+/**
+ * Runs three tasks with 100, 200 and 300 tickets under stride scheduling for TICKS clock ticks:
+ * each gets its share of the ticks, within two time slices.
+ */
+void checkStride()
+{
+    static const int COUNT = 3;
+    static const int TICKS = 6000;
+    TaskManager *taskManager = new TaskManager();
+    taskManager->SetPolicy(new StridePolicy());
+    CPUState initial;
+    int ticks[COUNT];
+    for (int i = 0; i < COUNT; i++)
+    {
+        Task *task = new Task((uint32_t)&initial);
+        task->SetTickets(100 * (i + 1));
+        taskManager->AddTask(task);
+        ticks[i] = 0;
+    }
+    taskManager->SetIdleTask(new Task((uint32_t)&initial));
+
+    CPUState *cpustate = taskManager->Schedule(&initial);
+    for (int i = 0; i < TICKS; i++)
+    {
+        ticks[taskManager->GetCurrentTask()->GetID()]++;
+        cpustate = taskManager->Schedule(cpustate);
+    }
+
+    int tolerance = 2 * taskManager->GetQuantum(0);
+    for (int i = 0; i < COUNT; i++)
+    {
+        int share = TICKS * (i + 1) / 6;
+        check(ticks[i] > share - tolerance && ticks[i] < share + tolerance, "stride shares the CPU by tickets");
+    }
+}
+
+/**
+ * The Internet checksum of a well-known IPv4 header is 0xB861, and the header carrying it sums to 0.
+ */
+void checkChecksum()
+{
+    uint8_t header[20] = { 0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11,
+                           0x00, 0x00, 0xC0, 0xA8, 0x00, 0x01, 0xC0, 0xA8, 0x00, 0xC7 };
+    uint16_t words[10];
+    for (int i = 0; i < 10; i++)
+        words[i] = header[2 * i] | header[2 * i + 1] << 8;
+
+    uint16_t checksum = InternetProtocolProvider::Checksum(words, sizeof(words));
+    check(checksum == toBigEndian16(0xB861), "checksum of the example header");
+    words[5] = checksum;
+    check(InternetProtocolProvider::Checksum(words, sizeof(words)) == 0, "checksum of a checked header");
+
+    // an odd length counts the last byte as the high byte of a word
+    uint8_t odd[3] = { 0x01, 0x02, 0x03 };
+    check(InternetProtocolProvider::Checksum((uint16_t *)odd, 3) == toBigEndian16(~0x0402 & 0xFFFF), "checksum of an odd length");
+}
+
+/**
+ * Measures the scheduler of one policy with NUM_TASKS READY tasks: yields, which always switch,
+ * and clock ticks, which switch when the running task is preempted. The tasks never run,
+ * only their CPU states are passed around.
+ */
+void benchmarkScheduler(char *yieldName, char *tickName, SchedulerPolicy *policy)
+{
+    static const int BATCH_SIZE = 64;
+    Benchmark yieldBenchmark(yieldName);
+    Benchmark tickBenchmark(tickName);
+
+    TaskManager *taskManager = new TaskManager();
+    taskManager->SetPolicy(policy);
+    CPUState initial;
+    for (int i = 0; i < NUM_TASKS; i++)
+        taskManager->AddTask(new Task((uint32_t)&initial));
+    taskManager->SetIdleTask(new Task((uint32_t)&initial));
+
+    CPUState *cpustate = taskManager->Schedule(&initial);
+    for (int batch = 0; batch < BATCHES; batch++)
+    {
+        uint64_t start = Benchmark::Now();
+        for (int i = 0; i < BATCH_SIZE; i++)
+            cpustate = taskManager->Yield(cpustate);
+        yieldBenchmark.Record((uint32_t)(Benchmark::Now() - start) / BATCH_SIZE);
+    }
+    for (int batch = 0; batch < BATCHES; batch++)
+    {
+        uint64_t start = Benchmark::Now();
+        for (int i = 0; i < BATCH_SIZE; i++)
+            cpustate = taskManager->Schedule(cpustate);
+        tickBenchmark.Record((uint32_t)(Benchmark::Now() - start) / BATCH_SIZE);
+    }
+
+    yieldBenchmark.Report();
+    tickBenchmark.Report();
+}
+
+void benchmarkChecksum()
+{
+    static const int BATCH_SIZE = 16;
+    Benchmark benchmark("checksum 1500");
+    uint16_t packet[PACKET_SIZE / 2];
+    for (int i = 0; i < PACKET_SIZE / 2; i++)
+        packet[i] = rng.NextInt();
+
+    uint32_t sum = 0;
+    for (int batch = 0; batch < BATCHES; batch++)
+    {
+        uint64_t start = Benchmark::Now();
+        for (int i = 0; i < BATCH_SIZE; i++)
+            sum += InternetProtocolProvider::Checksum(packet, PACKET_SIZE);
+        benchmark.Record((uint32_t)(Benchmark::Now() - start) / BATCH_SIZE);
+    }
+    if (sum == 1)
+        printf(""); // keeps the checksums from being optimized away
+    benchmark.Report();
+}
+
+// Accepts the data of the benchmark connection
+class CountingHandler : public TransmissionControlProtocolHandler
+{
+public:
+    uint32_t received;
+
+    CountingHandler()
+    {
+        received = 0;
+    }
+
+    bool HandleTransmissionControlProtocolMessage(TransmissionControlProtocolSocket *socket, uint8_t *data, uint16_t size)
+    {
+        received += size;
+        return true;
+    }
+};
+
+// The network stack of kernelMain on a network card whose ports do nothing
+PeripheralComponentInterconnectDeviceDescriptor device;
+amd_am79c973 *eth0;
+EtherFrameProvider *etherframe;
+AddressResolutionProtocol *arp;
+InternetProtocolProvider *ipv4;
+TransmissionControlProtocolProvider *tcp;
+
+struct Segment
+{
+    EtherFrameHeader ether;
+    InternetProtocolV4Message ip;
+    TransmissionControlProtocolHeader tcp;
+    uint8_t payload[SEGMENT_SIZE];
+} __attribute__((packed));
+
+/**
+ * Passes a segment from port 4000 of the remote host to a local port through the whole receive path,
+ * from the network card up.
+ */
+void receiveSegment(Segment *segment, uint16_t port, uint32_t sequenceNumber, uint8_t flags, int size)
+{
+    segment->ether.dstMAC_BE = 0xFFFFFFFFFFFF;
+    segment->ether.srcMAC_BE = 0x123456789ABC;
+    segment->ether.etherType_BE = 0x0008;
+
+    segment->ip.version = 4;
+    segment->ip.headerLength = sizeof(InternetProtocolV4Message) / 4;
+    segment->ip.tos = 0;
+    segment->ip.totalLength = toBigEndian16(sizeof(InternetProtocolV4Message) + sizeof(TransmissionControlProtocolHeader) + size);
+    segment->ip.ident = 0x0100;
+    segment->ip.flagsAndOffset = 0x0040;
+    segment->ip.timeToLive = 0x40;
+    segment->ip.protocol = 0x06;
+    segment->ip.srcIP = REMOTE_IP;
+    segment->ip.dstIP = LOCAL_IP;
+    segment->ip.checksum = 0;
+
+    // the header is not aligned within the packed segment, the checksum is taken over an aligned copy
+    uint16_t header[sizeof(InternetProtocolV4Message) / 2];
+    uint8_t *ip = (uint8_t *)&segment->ip;
+    for (int i = 0; i < sizeof(InternetProtocolV4Message); i++)
+        ((uint8_t *)header)[i] = ip[i];
+    segment->ip.checksum = InternetProtocolProvider::Checksum(header, sizeof(InternetProtocolV4Message));
+
+    segment->tcp.srcPort = toBigEndian16(4000);
+    segment->tcp.dstPort = toBigEndian16(port);
+    segment->tcp.sequenceNumber = toBigEndian32(sequenceNumber);
+    segment->tcp.acknowledgementNumber = 0;
+    segment->tcp.reserved = 0;
+    segment->tcp.headerSize32 = sizeof(TransmissionControlProtocolHeader) / 4;
+    segment->tcp.flags = flags;
+    segment->tcp.windowSize = 0xFFFF;
+    segment->tcp.checksum = 0;
+    segment->tcp.urgentPtr = 0;
+    segment->tcp.options = 0;
+
+    etherframe->OnRawDataReceived((uint8_t *)segment, sizeof(Segment) - SEGMENT_SIZE + size);
+}
+
+/**
+ * Receives data segments on an established connection, each one handled and acknowledged
+ * through IP, Ethernet and the network card.
+ */
+void benchmarkTcp()
+{
+    static const int BATCH_SIZE = 10;
+    Benchmark benchmark("tcp segment");
+
+    eth0 = new amd_am79c973(&device, new InterruptManager(0x20, 0, 0));
+    eth0->SetIPAddress(LOCAL_IP);
+    etherframe = new EtherFrameProvider(eth0);
+    arp = new AddressResolutionProtocol(etherframe);
+    ipv4 = new InternetProtocolProvider(etherframe, arp, REMOTE_IP, SUBNET_MASK);
+    tcp = new TransmissionControlProtocolProvider(ipv4);
+
+    // answers for the remote host, so sending never waits for ARP
+    AddressResolutionProtocolMessage reply;
+    reply.hardwareType = 0x0100;
+    reply.protocol = 0x0008;
+    reply.hardwareAddressSize = 6;
+    reply.protocolAddressSize = 4;
+    reply.command = 0x0200;
+    reply.srcMAC = 0x123456789ABC;
+    reply.srcIP = REMOTE_IP;
+    reply.dstMAC = 0;
+    reply.dstIP = LOCAL_IP;
+    arp->OnEtherFrameReceived((uint8_t *)&reply, sizeof(reply));
+
+    CountingHandler handler;
+    TransmissionControlProtocolSocket *socket = tcp->Listen(80);
+    tcp->Bind(socket, &handler);
+
+    Segment *segment = new Segment;
+    for (int i = 0; i < SEGMENT_SIZE; i++)
+        segment->payload[i] = 'a' + i % 26;
+    uint32_t sequenceNumber = 1000;
+    receiveSegment(segment, 80, sequenceNumber++, SYN, 0);
+    receiveSegment(segment, 80, sequenceNumber, ACK, 0);
+
+    for (int batch = 0; batch < BATCHES; batch++)
+    {
+        uint64_t start = Benchmark::Now();
+        for (int i = 0; i < BATCH_SIZE; i++)
+        {
+            receiveSegment(segment, 80, sequenceNumber, PSH | ACK, SEGMENT_SIZE);
+            sequenceNumber += SEGMENT_SIZE;
+        }
+        benchmark.Record((uint32_t)(Benchmark::Now() - start) / BATCH_SIZE);
+    }
+    benchmark.Report();
+
+    check(handler.received == (uint32_t)BATCHES * BATCH_SIZE * SEGMENT_SIZE, "tcp receives every segment");
+}
+
+/**
+ * Walks sockets on the stack of benchmarkTcp through the states of the handshake and both ways of closing,
+ * and resets a connection that is being opened.
+ */
+void checkTcp()
+{
+    static const uint16_t PASSIVE_PORT = 81;
+    static const uint16_t ACTIVE_PORT = 82;
+    Segment *segment = new Segment;
+    uint32_t sequenceNumber = 5000;
+
+    // the remote host opens and closes
+    TransmissionControlProtocolSocket *socket = tcp->Listen(PASSIVE_PORT);
+    check(socket->GetState() == LISTEN, "tcp listens");
+    receiveSegment(segment, PASSIVE_PORT, sequenceNumber++, SYN, 0);
+    check(socket->GetState() == SYN_RECEIVED, "tcp SYN moves LISTEN to SYN_RECEIVED");
+    receiveSegment(segment, PASSIVE_PORT, sequenceNumber, ACK, 0);
+    check(socket->GetState() == ESTABLISHED, "tcp ACK moves SYN_RECEIVED to ESTABLISHED");
+    receiveSegment(segment, PASSIVE_PORT, sequenceNumber, FIN | ACK, 0);
+    check(socket->GetState() == CLOSE_WAIT, "tcp FIN moves ESTABLISHED to CLOSE_WAIT");
+    receiveSegment(segment, PASSIVE_PORT, sequenceNumber + 1, ACK, 0);
+    check(socket->GetState() == CLOSED, "tcp ACK moves CLOSE_WAIT to CLOSED");
+
+    // the local side closes
+    socket = tcp->Listen(ACTIVE_PORT);
+    receiveSegment(segment, ACTIVE_PORT, sequenceNumber++, SYN, 0);
+    receiveSegment(segment, ACTIVE_PORT, sequenceNumber, ACK, 0);
+    socket->Disconnect();
+    check(socket->GetState() == FIN_WAIT1, "tcp disconnecting moves ESTABLISHED to FIN_WAIT1");
+    receiveSegment(segment, ACTIVE_PORT, sequenceNumber, ACK, 0);
+    check(socket->GetState() == FIN_WAIT2, "tcp ACK moves FIN_WAIT1 to FIN_WAIT2");
+    receiveSegment(segment, ACTIVE_PORT, sequenceNumber, FIN | ACK, 0);
+    check(socket->GetState() == CLOSED, "tcp FIN moves FIN_WAIT2 to CLOSED");
+
+    // the remote host refuses a connection
+    socket = tcp->Connect(REMOTE_IP, 4000);
+    check(socket->GetState() == SYN_SENT, "tcp connecting moves to SYN_SENT");
+    receiveSegment(segment, 1024, sequenceNumber, RST, 0);
+    check(socket->GetState() == CLOSED, "tcp RST moves SYN_SENT to CLOSED");
+    check(!socket->Send(segment->payload, 1), "tcp refuses to send on a reset connection");
+
+    delete segment;
+}
+
+int hostMain()
+{
+    MemoryManager memoryManager((size_t)heap, HEAP_SIZE);
+
+    printf("BENCHMARK        SAMPLES  MIN      MEDIAN   P99 (CYCLES PER OPERATION)\n");
+    benchmarkMalloc();
+    benchmarkSlab();
+    benchmarkArena();
+    benchmarkPriorityQueue();
+
+    benchmarkScheduler("yield rr", "tick rr", new RoundRobinPolicy());
+    benchmarkScheduler("yield prio", "tick prio", new PriorityPolicy());
+    benchmarkScheduler("yield mlfq", "tick mlfq", new FeedbackPolicy());
+    benchmarkScheduler("yield stride", "tick stride", new StridePolicy());
+
+    benchmarkChecksum();
+    benchmarkTcp();
+
+    printf("\n");
+    SlabCache::PrintStatistics();
+
+    checkPageFrames();
+    checkMalloc();
+    checkTlsf();
+    checkSlab();
+    checkArena();
+    checkTaskExhaustion();
+    checkPickOrder();
+    checkStride();
+    checkChecksum();
+    checkTcp();
+    if (failures != 0)
+        return 1;
+    printf("\nall checks passed\n");
+    return 0;
+}
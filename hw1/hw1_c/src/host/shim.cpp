@@ -0,0 +1,271 @@
+// Stand-ins for the parts of the kernel that need ring 0, so the core subsystems can be linked
+// into a 32-bit Linux program (make hostbench). Ports read as 0 and ignore writes, spinlocks leave
+// the interrupt flag alone, interrupt handlers are never called, and printf writes to stdout.
+
+#include <common/types.h>
+#include <spinlock.h>
+#include <fpu.h>
+#include <hardwarecommunication/port.h>
+#include <hardwarecommunication/interrupts.h>
+#include <hardwarecommunication/apic.h>
+
+using namespace myos;
+using namespace myos::common;
+using namespace myos::hardwarecommunication;
+
+static int hostSyscall(int number, int ebx, int ecx, int edx)
+{
+    int result;
+    asm volatile("int $0x80" : "=a"(result) : "a"(number), "b"(ebx), "c"(ecx), "d"(edx) : "memory");
+    return result;
+}
+
+void printf(char *str)
+{
+    int length = 0;
+    while (str[length] != '\0')
+        length++;
+    hostSyscall(4, 1, (int)str, length); // write to stdout
+}
+
+void printfHex(uint8_t key)
+{
+    char *hex = "0123456789ABCDEF";
+    char foo[3];
+    foo[0] = hex[(key >> 4) & 0xF];
+    foo[1] = hex[key & 0xF];
+    foo[2] = '\0';
+    printf(foo);
+}
+
+void printfHex32(uint32_t key)
+{
+    printfHex((key >> 24) & 0xFF);
+    printfHex((key >> 16) & 0xFF);
+    printfHex((key >> 8) & 0xFF);
+    printfHex(key & 0xFF);
+}
+
+int hostMain();
+
+typedef void (*constructor)();
+extern "C" constructor __init_array_start;
+extern "C" constructor __init_array_end;
+
+extern "C" void hostStart()
+{
+    for (constructor *i = &__init_array_start; i != &__init_array_end; i++)
+        (*i)();
+    hostSyscall(1, hostMain(), 0, 0); // exit
+}
+
+asm(".globl _start\n"
+    "_start:\n"
+    "    andl $-16, %esp\n"
+    "    call hostStart\n");
+
+Spinlock::Spinlock()
+{
+    locked = 0;
+}
+
+Spinlock::~Spinlock()
+{
+}
+
+void Spinlock::Acquire()
+{
+    while (!TryAcquire())
+        while (locked != 0)
+            asm volatile("pause");
+}
+
+bool Spinlock::TryAcquire()
+{
+    uint32_t previous = 1;
+    asm volatile("xchgl %0, %1" : "+r"(previous), "+m"(locked) : : "memory");
+    return previous == 0;
+}
+
+void Spinlock::Release()
+{
+    asm volatile("" : : : "memory");
+    locked = 0;
+}
+
+uint32_t Spinlock::AcquireIrqSave()
+{
+    Acquire();
+    return 0;
+}
+
+void Spinlock::ReleaseIrqRestore(uint32_t flags)
+{
+    Release();
+}
+
+SpinlockGuard::SpinlockGuard(Spinlock *lock)
+{
+    this->lock = lock;
+    flags = lock->AcquireIrqSave();
+}
+
+SpinlockGuard::~SpinlockGuard()
+{
+    lock->ReleaseIrqRestore(flags);
+}
+
+Port::Port(uint16_t portnumber)
+{
+    this->portnumber = portnumber;
+}
+
+Port::~Port()
+{
+}
+
+Port8Bit::Port8Bit(uint16_t portnumber)
+    : Port(portnumber)
+{
+}
+
+Port8Bit::~Port8Bit()
+{
+}
+
+uint8_t Port8Bit::Read()
+{
+    return 0;
+}
+
+void Port8Bit::Write(uint8_t data)
+{
+}
+
+Port8BitSlow::Port8BitSlow(uint16_t portnumber)
+    : Port8Bit(portnumber)
+{
+}
+
+Port8BitSlow::~Port8BitSlow()
+{
+}
+
+void Port8BitSlow::Write(uint8_t data)
+{
+}
+
+Port16Bit::Port16Bit(uint16_t portnumber)
+    : Port(portnumber)
+{
+}
+
+Port16Bit::~Port16Bit()
+{
+}
+
+uint16_t Port16Bit::Read()
+{
+    return 0;
+}
+
+void Port16Bit::Write(uint16_t data)
+{
+}
+
+Port32Bit::Port32Bit(uint16_t portnumber)
+    : Port(portnumber)
+{
+}
+
+Port32Bit::~Port32Bit()
+{
+}
+
+uint32_t Port32Bit::Read()
+{
+    return 0;
+}
+
+void Port32Bit::Write(uint32_t data)
+{
+}
+
+InterruptHandler::InterruptHandler(InterruptManager *interruptManager, uint8_t InterruptNumber)
+{
+    this->InterruptNumber = InterruptNumber;
+    this->interruptManager = interruptManager;
+    interruptManager->handlers[InterruptNumber] = this;
+}
+
+InterruptHandler::~InterruptHandler()
+{
+    if (interruptManager->handlers[InterruptNumber] == this)
+        interruptManager->handlers[InterruptNumber] = 0;
+}
+
+uint32_t InterruptHandler::HandleInterrupt(uint32_t esp)
+{
+    return esp;
+}
+
+InterruptManager::InterruptManager(uint16_t hardwareInterruptOffset, GlobalDescriptorTable *globalDescriptorTable, TaskManager *taskManager)
+    : programmableInterruptControllerMasterCommandPort(0x20),
+      programmableInterruptControllerMasterDataPort(0x21),
+      programmableInterruptControllerSlaveCommandPort(0xA0),
+      programmableInterruptControllerSlaveDataPort(0xA1)
+{
+    this->hardwareInterruptOffset = hardwareInterruptOffset;
+    this->taskManager = taskManager;
+    for (int i = 0; i < 256; i++)
+        handlers[i] = 0;
+    tickless = false;
+    timerMasked = false;
+}
+
+InterruptManager::~InterruptManager()
+{
+}
+
+uint16_t InterruptManager::HardwareInterruptOffset()
+{
+    return hardwareInterruptOffset;
+}
+
+uint8_t LocalAPIC::ID()
+{
+    return 0;
+}
+
+// CR0.TS as a flag, the registers are really saved and restored, fxsave works outside ring 0
+static bool taskSwitched = true;
+
+void FloatingPointUnit::Initialize()
+{
+    asm volatile("fninit");
+}
+
+void FloatingPointUnit::Save(uint8_t *state)
+{
+    asm volatile("fxsave (%0)" : : "r"(state) : "memory");
+}
+
+void FloatingPointUnit::Restore(uint8_t *state)
+{
+    asm volatile("fxrstor (%0)" : : "r"(state) : "memory");
+}
+
+void FloatingPointUnit::SetTaskSwitched()
+{
+    taskSwitched = true;
+}
+
+void FloatingPointUnit::ClearTaskSwitched()
+{
+    taskSwitched = false;
+}
+
+bool FloatingPointUnit::IsTaskSwitched()
+{
+    return taskSwitched;
+}
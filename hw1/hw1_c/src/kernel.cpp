@@ -10,9 +10,18 @@
 #include <drivers/mouse.h>
 #include <drivers/vga.h>
 #include <drivers/ata.h>
+#include <drivers/pit.h>
+#include <drivers/serial.h>
+#include <drivers/console.h>
+#include <drivers/terminal.h>
 #include <gui/desktop.h>
 #include <gui/window.h>
 #include <multitasking.h>
+#include <spinlock.h>
+#include <fpu.h>
+#include <benchmark.h>
+#include <smp.h>
+#include <hardwarecommunication/apic.h>
 
 #include <drivers/amd_am79c973.h>
 #include <net/etherframe.h>
@@ -25,6 +34,7 @@
 #include <rng.h>
 
 // #define GRAPHICSMODE
+// #define TOPVIEW
 
 using namespace myos;
 using namespace myos::common;
@@ -33,59 +43,13 @@ using namespace myos::hardwarecommunication;
 using namespace myos::gui;
 using namespace myos::net;
 
-bool newLinePressed = false;
-
-uint16_t *VideoMemory = (uint16_t *)0xb8000;
-uint8_t screenx = 0, screeny = 0;
 GlobalDescriptorTable gdt;
 TaskManager taskManager;
-
-void clearScreen()
-{
-    for (; screeny < 25; screeny++)
-        for (; screenx < 80; screenx++)
-            VideoMemory[80 * screeny + screenx] = (VideoMemory[80 * screeny + screenx] & 0xFF00) | ' ';
-    screenx = 0;
-    screeny = 0;
-}
+Console console;
 
 void printf(char *str)
 {
-
-    for (int i = 0; str[i] != '\0'; ++i)
-    {
-        switch (str[i])
-        {
-        case '\n':
-            screenx = 0;
-            screeny++;
-            break;
-        default:
-            VideoMemory[80 * screeny + screenx] = (VideoMemory[80 * screeny + screenx] & 0xFF00) | str[i];
-            screenx++;
-            break;
-        }
-
-        if (screenx >= 80)
-        {
-            screenx = 0;
-            screeny++;
-        }
-
-        if (screeny >= 25)
-        {
-            // taskManager.WaitEnter();
-            // while (!newLinePressed)
-            //     ;
-            // newLinePressed = false;
-            // taskManager.SignalEnter();
-            for (screeny = 0; screeny < 25; screeny++)
-                for (screenx = 0; screenx < 80; screenx++)
-                    VideoMemory[80 * screeny + screenx] = (VideoMemory[80 * screeny + screenx] & 0xFF00) | ' ';
-            screenx = 0;
-            screeny = 0;
-        }
-    }
+    console.Write(str);
 }
 
 void printfHex(uint8_t key)
@@ -109,45 +73,6 @@ void printfHex32(uint32_t key)
     printfHex(key & 0xFF);
 }
 
-class PrintfKeyboardEventHandler : public KeyboardEventHandler
-{
-public:
-    void OnKeyDown(char c)
-    {
-        char *foo = " ";
-        foo[0] = c;
-        printf(foo);
-        if (buffer_position == 256)
-            buffer_position = 0;
-        if (c == '\n')
-        {
-            pressedEnter = true;
-            enter_position = buffer_position;
-        }
-        buffer[buffer_position++] = c;
-    }
-
-    void GetBuffer(char *buf)
-    {
-        for (int i = 0; i < buffer_position; i++)
-            buf[i] = buffer[i];
-        buf[buffer_position] = 0;
-        buffer_position = 0;
-        pressedEnter = false;
-    }
-
-    bool PressedEnter()
-    {
-        return pressedEnter;
-    }
-
-private:
-    char buffer[256];
-    int buffer_position = 0;
-    int enter_position = 0;
-    bool pressedEnter = false;
-};
-
 class MouseToConsole : public MouseEventHandler
 {
     int8_t x, y;
@@ -155,17 +80,13 @@ class MouseToConsole : public MouseEventHandler
 public:
     MouseToConsole()
     {
-        uint16_t *VideoMemory = (uint16_t *)0xb8000;
         x = 40;
         y = 12;
-        VideoMemory[80 * y + x] = (VideoMemory[80 * y + x] & 0x0F00) << 4 | (VideoMemory[80 * y + x] & 0xF000) >> 4 | (VideoMemory[80 * y + x] & 0x00FF);
+        console.SetHighlight(x, y);
     }
 
     virtual void OnMouseMove(int xoffset, int yoffset)
     {
-        static uint16_t *VideoMemory = (uint16_t *)0xb8000;
-        VideoMemory[80 * y + x] = (VideoMemory[80 * y + x] & 0x0F00) << 4 | (VideoMemory[80 * y + x] & 0xF000) >> 4 | (VideoMemory[80 * y + x] & 0x00FF);
-
         x += xoffset;
         if (x >= 80)
             x = 79;
@@ -177,7 +98,7 @@ public:
         if (y < 0)
             y = 0;
 
-        VideoMemory[80 * y + x] = (VideoMemory[80 * y + x] & 0x0F00) << 4 | (VideoMemory[80 * y + x] & 0xF000) >> 4 | (VideoMemory[80 * y + x] & 0x00FF);
+        console.SetHighlight(x, y);
     }
 };
 
@@ -225,18 +146,7 @@ void sysprintf(char *str)
 /*-------------------*/
 /*---===HW CODE===---*/
 
-PrintfKeyboardEventHandler kbhandler;
-
-/**
- * @brief Forks a new task
- *
- * @param esp The current stack pointer
- * @return int The new task id
- */
-int __fork(uint32_t esp)
-{
-    return taskManager.fork(esp);
-}
+Terminal terminal;
 
 /**
  * @brief Waits for a task to finish
@@ -257,22 +167,44 @@ int __fork(uint32_t esp)
  * @brief Waits for a task to finish
  *
  * @param pid The pid of the task to wait for
+ * @return int The pid, once the task has exited
+ */
+#define waitpid(pid)                                                      \
+    ({                                                                    \
+        int result;                                                       \
+        asm volatile("int $0x80" : "=a"(result) : "a"(7), "b"(pid)        \
+                     : "memory");                                         \
+        result;                                                           \
+    })
+
+/**
+ * @brief Waits for all of the given tasks to finish
+ *
+ * @param pids The pids of the tasks to wait for
+ * @param n The number of pids, at most Task::MAX_WAIT (16)
+ * @return int The pid of the task that exited last, -1 without waiting if n exceeds Task::MAX_WAIT
  */
-#define waitpid(pid)                           \
-    ({                                         \
-        asm("int $0x20" : : "a"(7), "b"(pid)); \
+#define waitpids(pids, n)                                                    \
+    ({                                                                       \
+        int result;                                                          \
+        asm volatile("int $0x80" : "=a"(result) : "a"(8), "b"(pids), "c"(n), \
+                     "d"(0) : "memory");                                     \
+        result;                                                              \
     })
 
-#define waitpids(pids, n)                                      \
-    ({                                                         \
-        for (int i = 0; i < n; i++)                            \
-        {                                                      \
-            taskManager.GetCurrentTask()->locals[i] = pids[i]; \
-        }                                                      \
-        for (int i = 0; i < n; i++)                            \
-        {                                                      \
-            waitpid(taskManager.GetCurrentTask()->locals[i]);  \
-        }                                                      \
+/**
+ * @brief Waits for any of the given tasks to finish
+ *
+ * @param pids The pids of the tasks to wait for
+ * @param n The number of pids, at most Task::MAX_WAIT (16)
+ * @return int The pid of the task that finished, -1 without waiting if n exceeds Task::MAX_WAIT
+ */
+#define waitany(pids, n)                                                     \
+    ({                                                                       \
+        int result;                                                          \
+        asm volatile("int $0x80" : "=a"(result) : "a"(8), "b"(pids), "c"(n), \
+                     "d"(1) : "memory");                                     \
+        result;                                                              \
     })
 
 /**
@@ -280,9 +212,91 @@ int __fork(uint32_t esp)
  */
 #define exit()                     \
     {                              \
-        asm("int $0x20" ::"a"(1)); \
+        asm("int $0x80" ::"a"(1)); \
     }
 
+/**
+ * @brief Puts the current task to sleep
+ *
+ * @param ms The time to sleep in milliseconds
+ */
+#define sleep(ms)                                                         \
+    ({                                                                    \
+        int result;                                                       \
+        asm volatile("int $0x80" : "=a"(result) : "a"(162), "b"(ms)       \
+                     : "memory");                                         \
+        result;                                                           \
+    })
+
+/**
+ * @brief Gives up the CPU to the next ready task
+ */
+#define yield()                                                           \
+    ({                                                                    \
+        int result;                                                       \
+        asm volatile("int $0x80" : "=a"(result) : "a"(158) : "memory");   \
+        result;                                                           \
+    })
+
+/**
+ * @brief Reads a line from the console, sleeping until one is entered
+ *
+ * @param fd The file descriptor, only 0 (the console) is supported
+ * @param buffer Where to copy the line to, not zero-terminated
+ * @param size The size of the buffer
+ * @return int The number of characters read, the newline included, or -1 on error
+ */
+#define read(fd, buffer, size)                                            \
+    ({                                                                    \
+        int result;                                                       \
+        asm volatile("int $0x80" : "=a"(result) : "a"(3), "b"(fd),        \
+                     "c"(buffer), "d"(size) : "memory");                  \
+        result;                                                           \
+    })
+
+/**
+ * @brief Copies the CPU accounting of a task
+ *
+ * @param pid The pid of the task
+ * @param statistics Where to copy the accounting to
+ * @return int 1 if filled, 0 if the pid is unused, -1 past the last pid
+ */
+#define taskstats(pid, statistics)                                        \
+    ({                                                                    \
+        int result;                                                       \
+        asm volatile("int $0x80" : "=a"(result) : "a"(116), "b"(pid),     \
+                     "c"(statistics) : "memory");                         \
+        result;                                                           \
+    })
+
+/**
+ * @brief Sets the share of the CPU of the current task under stride scheduling (sched=stride)
+ *
+ * @param tickets The number of tickets, clamped to [1, 10000], 100 by default
+ */
+#define settickets(tickets)                                               \
+    ({                                                                    \
+        int result;                                                       \
+        asm volatile("int $0x80" : "=a"(result) : "a"(34), "b"(tickets)   \
+                     : "memory");                                         \
+        result;                                                           \
+    })
+
+/**
+ * @brief Runs the current task ahead of all other tasks, earliest deadline first
+ *
+ * @param period The period in milliseconds
+ * @param budget The CPU time per period in milliseconds, 0 to leave the deadline class
+ * @return int 0 if admitted, -1 if the deadlines of all deadline tasks could not be met
+ */
+#define setdeadline(period, budget)                                       \
+    ({                                                                    \
+        int result;                                                       \
+        asm volatile("int $0x80" : "=a"(result) : "a"(351), "b"(period),  \
+                     "c"(budget) : "memory");                             \
+        result;                                                           \
+    })
+
 /**
  * @brief Executes a new task
  *
@@ -291,9 +305,12 @@ int __fork(uint32_t esp)
 void execve(void entrypoint())
 {
     Task *task = new Task(&gdt, entrypoint);
-    task->SetPriority(taskManager.GetCurrentTask()->GetPriority() + 1);
-    taskManager.AddTask(task);
-    waitpid(task->GetID());
+    if (task != 0)
+    {
+        task->SetPriority(taskManager.GetCurrentTask()->GetPriority() + 1);
+        taskManager.AddTask(task);
+        waitpid(task->GetID());
+    }
     exit();
 }
 
@@ -307,20 +324,8 @@ void get_uint_array(int *arr, int size)
         printfHex32(size);
     printf(" numbers: ");
 
-    bool pressedEnter = false;
-    while (!pressedEnter)
-    {
-        for (int i = 0; i < 1000000000; i++)
-        {
-            if (kbhandler.PressedEnter())
-            {
-                pressedEnter = true;
-                break;
-            }
-        }
-    }
-
-    kbhandler.GetBuffer(buffer);
+    int length = read(0, buffer, 255);
+    buffer[length > 0 ? length : 0] = 0;
 
     size = size < 256 ? size : 256;
     for (int i = 0, j = 0; i < size; i++)
@@ -338,20 +343,8 @@ void get_uint(int *n)
     char buffer[256];
     printf("Enter a number: ");
 
-    bool pressedEnter = false;
-    while (!pressedEnter)
-    {
-        for (int i = 0; i < 1000000000; i++)
-        {
-            if (kbhandler.PressedEnter())
-            {
-                pressedEnter = true;
-                break;
-            }
-        }
-    }
-
-    kbhandler.GetBuffer(buffer);
+    int length = read(0, buffer, 255);
+    buffer[length > 0 ? length : 0] = 0;
 
     *n = 0;
     int j = 0;
@@ -520,8 +513,270 @@ void linearSearch()
     exit();
 }
 
+/**
+ * @brief Prints the CPU accounting of all tasks once a second
+ */
+void top()
+{
+    taskManager.SetPriority(0);
+    setdeadline(1000, 20);
+    char *states[] = {"RUN", "RDY", "BLK", "SLP", "EXT"};
+    TaskStatistics statistics;
+
+    while (1)
+    {
+        sleep(1000);
+        printf("PID      ST  RUN      READY    BLOCKED  SWITCHES VOLUNTARY\n");
+        int found;
+        for (int pid = 0; (found = taskstats(pid, &statistics)) >= 0; pid++)
+        {
+            if (found == 0)
+                continue;
+            printfHex32(statistics.pid);
+            printf(" ");
+            printf(states[statistics.state]);
+            printf(" ");
+            printfHex32(statistics.runningTicks);
+            printf(" ");
+            printfHex32(statistics.readyTicks);
+            printf(" ");
+            printfHex32(statistics.blockedTicks);
+            printf(" ");
+            printfHex32(statistics.switches);
+            printf(" ");
+            printfHex32(statistics.voluntarySwitches);
+            printf("\n");
+        }
+        printf("Idle ticks: ");
+        printfHex32(taskManager.GetIdleTicks());
+        printf(" of ");
+        printfHex32(taskManager.GetClockCounter() * taskManager.GetNumProcessors());
+        printf("\n");
+    }
+}
+
 /*---------------------------------*/
 
+Benchmark rdtscBenchmark("rdtsc");
+Benchmark syscallBenchmark("syscall");
+Benchmark interruptBenchmark("interrupt");
+Benchmark switchBenchmark("switch");
+Benchmark mallocBenchmark("malloc");
+Benchmark freeBenchmark("free");
+Benchmark forkBenchmark("fork");
+/**
+ * @brief Ends a headless run: sends out the console output, then stops QEMU through its
+ * isa-debug-exit device, which makes it exit with status 1. Elsewhere the caller just goes on.
+ */
+void powerOff()
+{
+    console.Drain();
+    Port8Bit debugExit(0xF4);
+    debugExit.Write(0);
+}
+
+volatile uint64_t switchStart; // time stamp taken by one side of the switch benchmark before it yields
+
+/**
+ * @brief The other side of the switch benchmark, every yield switches back to the benchmark task
+ */
+void switchPartner()
+{
+    for (int i = 0; i < Benchmark::MAX_SAMPLES / 2; i++)
+    {
+        switchStart = Benchmark::Now();
+        yield();
+        // the last yield returns once the benchmark task waits for the exit, which is no switch sample
+        if (i < Benchmark::MAX_SAMPLES / 2 - 1)
+            switchBenchmark.Record(Benchmark::Now() - switchStart);
+    }
+    exit();
+}
+
+/**
+ * @brief Measures the cost of the basic kernel operations in cycles, selected with the boot argument bench
+ */
+void benchmark()
+{
+    for (int i = 0; i < Benchmark::MAX_SAMPLES; i++)
+    {
+        uint64_t start = Benchmark::Now();
+        rdtscBenchmark.Record(Benchmark::Now() - start);
+    }
+
+    // syscall 0 is not assigned, so only the dispatch through SyscallHandler is measured
+    for (int i = 0; i < Benchmark::MAX_SAMPLES; i++)
+    {
+        uint64_t start = Benchmark::Now();
+        asm volatile("int $0x80" : : "a"(0) : "memory");
+        syscallBenchmark.Record(Benchmark::Now() - start);
+    }
+
+    // the breakpoint exception has no handler, it only passes through int_bottom and InterruptManager
+    for (int i = 0; i < Benchmark::MAX_SAMPLES; i++)
+    {
+        uint64_t start = Benchmark::Now();
+        asm volatile("int $0x03" : : : "memory");
+        interruptBenchmark.Record(Benchmark::Now() - start);
+    }
+
+    for (int i = 0; i < Benchmark::MAX_SAMPLES; i++)
+    {
+        size_t size = 16 << (i % 8);
+        uint64_t start = Benchmark::Now();
+        void *memory = MemoryManager::activeMemoryManager->malloc(size);
+        uint64_t allocated = Benchmark::Now();
+        MemoryManager::activeMemoryManager->free(memory);
+        uint64_t freed = Benchmark::Now();
+        mallocBenchmark.Record(allocated - start);
+        freeBenchmark.Record(freed - allocated);
+    }
+
+    // a yield with one other ready task is one switch there and one back
+    Task *partner = new Task(&gdt, switchPartner);
+    if (partner == 0)
+    {
+        printf("benchmark: out of memory\n");
+        exit();
+    }
+    taskManager.AddTask(partner);
+    int partnerPid = partner->GetID(); // the partner may be reaped before it is waited for
+    for (int i = 0; i < Benchmark::MAX_SAMPLES / 2; i++)
+    {
+        switchStart = Benchmark::Now();
+        yield();
+        switchBenchmark.Record(Benchmark::Now() - switchStart);
+    }
+    waitpid(partnerPid);
+
+    // the child exits right away, the parent goes on without switching
+    for (int i = 0; i < Benchmark::MAX_SAMPLES / 4; i++)
+    {
+        uint64_t start = Benchmark::Now();
+        int pid = fork();
+        if (pid == 0)
+            exit();
+        forkBenchmark.Record(Benchmark::Now() - start);
+        waitpid(pid);
+    }
+
+    printf("BENCHMARK        SAMPLES  MIN      MEDIAN   P99 (CYCLES)\n");
+    rdtscBenchmark.Report();
+    syscallBenchmark.Report();
+    interruptBenchmark.Report();
+    switchBenchmark.Report();
+    mallocBenchmark.Report();
+    freeBenchmark.Report();
+    forkBenchmark.Report();
+    powerOff();
+    exit();
+}
+
+struct Workload
+{
+    char *name;
+    void (*entrypoint)();
+    char *input; // the lines a user would type at its prompts
+};
+
+/**
+ * @brief The long running program with three times the default tickets, under sched=stride
+ * it gets three times the CPU of the plain one while both run
+ */
+void long_running_3x()
+{
+    settickets(300);
+    long_running_program();
+}
+
+Workload workloads[] = {
+    {"collatz", collatz_sequence, "200\n"},
+    {"long_running", long_running_program, "3000\n"},
+    {"long_running_3x", long_running_3x, "3000\n"},
+    {"binary_search", binarySearch, "1 3 5 7 9 11 13 15\n9\n"},
+    {"linear_search", linearSearch, "10 20 80 30 60 50 110 100 130 170\n110\n"},
+};
+const int NUM_WORKLOADS = sizeof(workloads) / sizeof(workloads[0]);
+
+/**
+ * @brief Runs the programs of init with scripted input and reports how the scheduler served them,
+ * selected with the boot argument workload
+ *
+ * Prints one line per program with its response time (arrival to first run), turnaround time
+ * (arrival to exit) and CPU accounting, then the makespan of the whole mix, all in clock ticks.
+ */
+void workload()
+{
+    int pids[NUM_WORKLOADS];
+    TaskStatistics statistics[NUM_WORKLOADS];
+    taskManager.SetPriority(3);
+
+    for (int i = 0; i < NUM_WORKLOADS; i++)
+    {
+        Task *task = new Task(&gdt, workloads[i].entrypoint);
+        if (task == 0)
+        {
+            printf("workload: out of memory\n");
+            exit();
+        }
+        task->SetPriority(2); // as execve from init gives them
+        task->SetInput(workloads[i].input);
+        taskManager.AddTask(task);
+        pids[i] = task->GetID();
+    }
+
+    // the programs stay zombies until they are waited for, so their statistics can be read after they exit
+    for (int i = 0; i < NUM_WORKLOADS; i++)
+    {
+        while (taskstats(pids[i], &statistics[i]) == 1 && statistics[i].state != TaskState::EXITED)
+            sleep(10);
+    }
+    waitpids(pids, NUM_WORKLOADS);
+
+    uint32_t first = statistics[0].arrivalTick;
+    uint32_t last = statistics[0].exitTick;
+    printf("WORKLOAD         PID      TICKETS  RESPONSE TURNARND RUNNING  READY    BLOCKED  SWITCHES\n");
+    for (int i = 0; i < NUM_WORKLOADS; i++)
+    {
+        printf(workloads[i].name);
+        int length = 0;
+        while (workloads[i].name[length] != '\0')
+            length++;
+        for (int j = length; j < 17; j++)
+            printf(" ");
+
+        printfHex32(pids[i]);
+        printf(" ");
+        printfHex32(statistics[i].tickets);
+        printf(" ");
+        printfHex32(statistics[i].firstRunTick - statistics[i].arrivalTick);
+        printf(" ");
+        printfHex32(statistics[i].exitTick - statistics[i].arrivalTick);
+        printf(" ");
+        printfHex32(statistics[i].runningTicks);
+        printf(" ");
+        printfHex32(statistics[i].readyTicks);
+        printf(" ");
+        printfHex32(statistics[i].blockedTicks);
+        printf(" ");
+        printfHex32(statistics[i].switches);
+        printf("\n");
+
+        if (statistics[i].arrivalTick < first)
+            first = statistics[i].arrivalTick;
+        if (statistics[i].exitTick > last)
+            last = statistics[i].exitTick;
+    }
+    printf("MAKESPAN         ");
+    printfHex32(last - first);
+    printf("\nTICKRATE         ");
+    printfHex32(taskManager.GetTickRate());
+    printf("\n\n");
+    SlabCache::PrintStatistics();
+    powerOff();
+    exit();
+}
+
 void init()
 {
     int pids[4];
@@ -547,6 +802,12 @@ void init()
     {
         execve(linearSearch);
     }
+#ifdef TOPVIEW
+    if (fork() == 0)
+    {
+        execve(top);
+    }
+#endif
     taskManager.SetPriority(0);
     exit();
 }
@@ -554,6 +815,104 @@ void init()
 /*---===HW CODE===---*/
 /*-------------------*/
 
+/**
+ * @brief Runs whenever no other task is ready, halting the CPU until the next interrupt
+ */
+void idle()
+{
+    while (1)
+        asm volatile("hlt");
+}
+
+InterruptManager *processorInterrupts; // the interrupt manager the application processors join
+uint32_t processorTimerCount;          // local APIC timer count for one clock tick
+uint32_t processorLocalAPIC;           // address of the local APICs from the MP tables
+
+/**
+ * @brief Entry point of the application processors, called on a fresh stack by the startup trampoline
+ */
+void startProcessor()
+{
+    gdt.Load();
+    LocalAPIC::Enable(processorLocalAPIC, false);
+    FloatingPointUnit::Enable();
+    uint8_t apicId = LocalAPIC::ID();
+
+    uint8_t *interruptStack = new uint8_t[MultiProcessor::STACK_SIZE];
+    if (interruptStack == 0 || taskManager.AddProcessor(apicId, new Task(&gdt, idle)) < 0)
+    {
+        MultiProcessor::ProcessorStarted();
+        while (1)
+            asm volatile("cli; hlt");
+    }
+    InterruptManager::SetProcessorStack(apicId, (uint32_t)(interruptStack + MultiProcessor::STACK_SIZE));
+    LocalAPIC::StartTimer(processorInterrupts->HardwareInterruptOffset() + InterruptManager::LOCAL_TIMER_IRQ,
+                          processorTimerCount);
+    MultiProcessor::ProcessorStarted();
+
+    processorInterrupts->ActivateProcessor();
+    while (1)
+        asm volatile("hlt");
+}
+
+/**
+ * @brief Brings up the application processors, each with its own run queue and a local APIC timer
+ * at the clock rate. Only the local APICs are used: device interrupts stay with the 8259 PICs
+ * on the boot processor, the I/O APIC is masked.
+ *
+ * @param smp The processors found in the MP tables
+ * @param interrupts The interrupt manager of the boot processor
+ * @return int The number of application processors started
+ */
+int startProcessors(MultiProcessor *smp, InterruptManager *interrupts)
+{
+    processorLocalAPIC = smp->GetLocalAPICAddress();
+    LocalAPIC::Enable(processorLocalAPIC, true);
+    processorTimerCount = LocalAPIC::CalibrateTimer(taskManager.GetTickRate());
+    processorInterrupts = interrupts;
+
+    // only the 8259s deliver device interrupts, keep the I/O APIC from delivering them a second time
+    if (smp->GetIOAPICAddress() != 0)
+    {
+        IOAPIC ioApic(smp->GetIOAPICAddress());
+        ioApic.MaskAll();
+    }
+
+    uint8_t *interruptStack = new uint8_t[MultiProcessor::STACK_SIZE];
+    if (interruptStack == 0)
+        return 0;
+    InterruptManager::SetProcessorStack(LocalAPIC::ID(), (uint32_t)(interruptStack + MultiProcessor::STACK_SIZE));
+    InterruptManager::EnableProcessorStacks(smp->GetLocalAPICAddress());
+
+    return smp->StartApplicationProcessors(startProcessor);
+}
+
+
+/**
+ * @brief Checks whether the boot loader passed an argument on the kernel command line
+ *
+ * @param multiboot_structure The multiboot information
+ * @param argument The argument to look for, e.g. "sched=rr"
+ * @return true if the command line contains the argument
+ */
+bool hasBootArgument(const void *multiboot_structure, char *argument)
+{
+    uint32_t flags = *(uint32_t *)multiboot_structure;
+    if (!(flags & (1 << 2)))
+        return false;
+
+    char *cmdline = *(char **)(((size_t)multiboot_structure) + 16);
+    for (int i = 0; cmdline[i] != '\0'; i++)
+    {
+        int j = 0;
+        while (argument[j] != '\0' && cmdline[i + j] == argument[j])
+            j++;
+        if (argument[j] == '\0' && (cmdline[i + j] == ' ' || cmdline[i + j] == '\0'))
+            return true;
+    }
+    return false;
+}
+
 typedef void (*constructor)();
 extern "C" constructor start_ctors;
 extern "C" constructor end_ctors;
@@ -563,19 +922,49 @@ extern "C" void callConstructors()
         (*i)();
 }
 
+extern "C" uint8_t kernel_end;
+
 extern "C" void kernelMain(const void *multiboot_structure, uint32_t /*multiboot_magic*/)
 {
 
-    uint32_t *memupper = (uint32_t *)(((size_t)multiboot_structure) + 8);
-    size_t heap = 10 * 1024 * 1024;
-    MemoryManager memoryManager(heap, (*memupper) * 1024 - heap - 10 * 1024);
+    // all RAM in the memory map above the kernel, the heap grows from it
+    PageFrameAllocator pageFrameAllocator(multiboot_structure, (size_t)&kernel_end);
+    MemoryManager memoryManager;
     void *allocated = memoryManager.malloc(1024);
 
-    Task *init_task = new Task(&gdt, init);
+    // scheduler policy, selected with sched=rr, sched=prio (default), sched=mlfq or sched=stride
+    if (hasBootArgument(multiboot_structure, "sched=rr"))
+        taskManager.SetPolicy(new RoundRobinPolicy());
+    else if (hasBootArgument(multiboot_structure, "sched=mlfq"))
+        taskManager.SetPolicy(new FeedbackPolicy());
+    else if (hasBootArgument(multiboot_structure, "sched=stride"))
+        taskManager.SetPolicy(new StridePolicy());
+    else
+        taskManager.SetPolicy(new PriorityPolicy());
+
+    // the benchmark replaces the programs and runs on the boot processor only, so switches stay comparable.
+    // workload runs the programs with scripted input and reports their response and turnaround times
+    bool benchmarkMode = hasBootArgument(multiboot_structure, "bench");
+    void (*entrypoint)() = init;
+    if (benchmarkMode)
+        entrypoint = benchmark;
+    else if (hasBootArgument(multiboot_structure, "workload"))
+        entrypoint = workload;
+    Task *init_task = new Task(&gdt, entrypoint);
     taskManager.AddTask(init_task);
+    taskManager.SetIdleTask(new Task(&gdt, idle));
+
+    // processors from the MP tables, unless booted with nosmp
+    MultiProcessor smp;
+    bool multiprocessor = !benchmarkMode && !hasBootArgument(multiboot_structure, "nosmp") && smp.Detect() &&
+                          smp.GetNumProcessors() > 1;
 
     InterruptManager interrupts(0x20, &gdt, &taskManager);
-    SyscallHandler syscalls(&interrupts, 0x80);
+    SyscallHandler syscalls(&interrupts, 0x80, &taskManager);
+    FloatingPointUnit fpu(&interrupts, &taskManager);
+    FloatingPointUnit::Enable();
+    // the clock of the boot processor also drives the other processors' accounting, so it keeps running
+    interrupts.SetTickless(!multiprocessor);
 
     // printf("Initializing Hardware, Stage 1\n");
 
@@ -588,7 +977,7 @@ extern "C" void kernelMain(const void *multiboot_structure, uint32_t /*multiboot
 #ifdef GRAPHICSMODE
     KeyboardDriver keyboard(&interrupts, &desktop);
 #else
-    KeyboardDriver keyboard(&interrupts, &kbhandler);
+    KeyboardDriver keyboard(&interrupts, &terminal);
 #endif
     drvManager.AddDriver(&keyboard);
 
@@ -603,6 +992,14 @@ extern "C" void kernelMain(const void *multiboot_structure, uint32_t /*multiboot
     PeripheralComponentInterconnectController PCIController;
     PCIController.SelectDrivers(&drvManager, &interrupts);
 
+    ProgrammableIntervalTimer pit(1000);
+    drvManager.AddDriver(&pit);
+    taskManager.SetTickRate(pit.GetFrequency());
+
+    // added after the PCI drivers, which are looked up by index below
+    SerialPort serial(&interrupts, &terminal);
+    drvManager.AddDriver(&serial);
+
 #ifdef GRAPHICSMODE
     VideoGraphicsArray vga;
 #endif
@@ -610,6 +1007,11 @@ extern "C" void kernelMain(const void *multiboot_structure, uint32_t /*multiboot
     // printf("Initializing Hardware, Stage 2\n");
     drvManager.ActivateAll();
 
+    // the console is the screen, console=serial moves it to COM1 and console=both mirrors it there
+    if (hasBootArgument(multiboot_structure, "console=serial") || hasBootArgument(multiboot_structure, "console=both"))
+        console.SetSerial(&serial);
+    console.SetScreen(!hasBootArgument(multiboot_structure, "console=serial"));
+
     // printf("Initializing Hardware, Stage 3\n");
 
 #ifdef GRAPHICSMODE
@@ -664,6 +1066,9 @@ extern "C" void kernelMain(const void *multiboot_structure, uint32_t /*multiboot
     UserDatagramProtocolProvider udp(&ipv4);
     TransmissionControlProtocolProvider tcp(&ipv4);
 
+    if (multiprocessor)
+        startProcessors(&smp, &interrupts);
+
     interrupts.Activate();
 
     while (1)
@@ -671,5 +1076,6 @@ extern "C" void kernelMain(const void *multiboot_structure, uint32_t /*multiboot
 #ifdef GRAPHICSMODE
         desktop.Draw(&vga);
 #endif
+        asm volatile("hlt");
     }
 }
@@ -32,3 +32,5 @@ _stop:
 .space 2*1024*1024; # 2 MiB
 kernel_stack:
 
+
+.section .note.GNU-stack,"",@progbits
@@ -6,44 +6,192 @@ using namespace myos::common;
 
 
 MemoryManager* MemoryManager::activeMemoryManager = 0;
+
+static inline int HighestBit(uint32_t value)
+{
+    uint32_t bit;
+    asm("bsr %1, %0" : "=r"(bit) : "r"(value));
+    return bit;
+}
+
+static inline int LowestBit(uint32_t value)
+{
+    uint32_t bit;
+    asm("bsf %1, %0" : "=r"(bit) : "r"(value));
+    return bit;
+}
         
-MemoryManager::MemoryManager(size_t start, size_t size)
+/**
+ * Creates an empty heap that takes all its memory from the page frame allocator.
+ */
+MemoryManager::MemoryManager()
 {
     activeMemoryManager = this;
     
-    if(size < sizeof(MemoryChunk))
+    first = 0;
+    firstLevelBitmap = 0;
+    for(int i = 0; i < FIRST_LEVEL_COUNT; i++)
     {
-        first = 0;
-    }
-    else
-    {
-        first = (MemoryChunk*)start;
-        
-        first -> allocated = false;
-        first -> prev = 0;
-        first -> next = 0;
-        first -> size = size - sizeof(MemoryChunk);
+        secondLevelBitmap[i] = 0;
+        for(int j = 0; j < SECOND_LEVEL_COUNT; j++)
+            freeLists[i][j] = 0;
     }
 }
 
+/**
+ * Creates a heap in a fixed block of memory, which grows from the page frame allocator if there is one.
+ *
+ * @param start The first byte of the block.
+ * @param size The size of the block.
+ */
+MemoryManager::MemoryManager(size_t start, size_t size)
+    : MemoryManager()
+{
+    AddRegion(start, size);
+}
+
 MemoryManager::~MemoryManager()
 {
     if(activeMemoryManager == this)
         activeMemoryManager = 0;
 }
+
+/**
+ * Adds a block of memory to the heap as one free chunk. Chunks are never merged across regions.
+ */
+void MemoryManager::AddRegion(size_t start, size_t size)
+{
+    // chunks and sizes are multiples of ALIGNMENT, so every block handed out is aligned
+    size_t end = start + size;
+    start = (start + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    size = end > start ? (end - start) & ~(ALIGNMENT - 1) : 0;
+    
+    if(size < sizeof(MemoryChunk) + ALIGNMENT)
+        return;
+    
+    MemoryChunk* chunk = (MemoryChunk*)start;
+    chunk -> allocated = false;
+    chunk -> prev = 0;
+    chunk -> next = 0;
+    chunk -> size = size - sizeof(MemoryChunk);
+    InsertFree(chunk);
+    if(first == 0)
+        first = chunk;
+}
+
+/**
+ * Takes a new region of at least GROWTH bytes from the page frame allocator. The lock must be held.
+ *
+ * @param size The size of the allocation that did not fit.
+ * @return False if there is no page frame allocator or it is out of memory.
+ */
+bool MemoryManager::Grow(size_t size)
+{
+    PageFrameAllocator* pageFrameAllocator = PageFrameAllocator::activePageFrameAllocator;
+    if(pageFrameAllocator == 0)
+        return false;
+    
+    // FindFree rounds the size up to the next size class, at most size / SECOND_LEVEL_COUNT more
+    size_t needed = size + (size >> SECOND_LEVEL_LOG2) + sizeof(MemoryChunk);
+    int order = PageFrameAllocator::Order(needed < GROWTH ? GROWTH : needed);
+    void* region = pageFrameAllocator->AllocatePages(order);
+    if(region == 0)
+        return false;
+    AddRegion((size_t)region, PageFrameAllocator::PAGE_SIZE << order);
+    return true;
+}
+
+/**
+ * Maps a size to its free list.
+ *
+ * @param size The size, at least ALIGNMENT.
+ * @param firstLevel Set to the power of two below the size.
+ * @param secondLevel Set to the range within that power of two.
+ */
+void MemoryManager::Mapping(size_t size, int *firstLevel, int *secondLevel)
+{
+    *firstLevel = HighestBit(size);
+    *secondLevel = (size >> (*firstLevel - SECOND_LEVEL_LOG2)) & (SECOND_LEVEL_COUNT - 1);
+}
+
+void MemoryManager::InsertFree(MemoryChunk *chunk)
+{
+    int firstLevel, secondLevel;
+    Mapping(chunk->size, &firstLevel, &secondLevel);
+    
+    chunk->prevFree = 0;
+    chunk->nextFree = freeLists[firstLevel][secondLevel];
+    if(chunk->nextFree != 0)
+        chunk->nextFree->prevFree = chunk;
+    freeLists[firstLevel][secondLevel] = chunk;
+    
+    firstLevelBitmap |= 1u << firstLevel;
+    secondLevelBitmap[firstLevel] |= 1u << secondLevel;
+}
+
+void MemoryManager::RemoveFree(MemoryChunk *chunk)
+{
+    int firstLevel, secondLevel;
+    Mapping(chunk->size, &firstLevel, &secondLevel);
+    
+    if(chunk->nextFree != 0)
+        chunk->nextFree->prevFree = chunk->prevFree;
+    if(chunk->prevFree != 0)
+        chunk->prevFree->nextFree = chunk->nextFree;
+    else
+    {
+        freeLists[firstLevel][secondLevel] = chunk->nextFree;
+        if(chunk->nextFree == 0)
+        {
+            secondLevelBitmap[firstLevel] &= ~(1u << secondLevel);
+            if(secondLevelBitmap[firstLevel] == 0)
+                firstLevelBitmap &= ~(1u << firstLevel);
+        }
+    }
+}
+
+/**
+ * Finds a free chunk of at least the given size without walking any list. The size is rounded
+ * up to the next size class, so the first chunk of any list from there on is large enough.
+ *
+ * @param size The size, a multiple of ALIGNMENT.
+ * @return The chunk, still in its free list, or 0 if none is large enough.
+ */
+MemoryChunk* MemoryManager::FindFree(size_t size)
+{
+    int firstLevel, secondLevel;
+    Mapping(size + (1u << (HighestBit(size) - SECOND_LEVEL_LOG2)) - 1, &firstLevel, &secondLevel);
+    
+    uint32_t bitmap = secondLevelBitmap[firstLevel] & (~0u << secondLevel);
+    if(bitmap == 0)
+    {
+        // a larger power of two, where any list will do
+        if(firstLevel + 1 >= FIRST_LEVEL_COUNT)
+            return 0;
+        uint32_t larger = firstLevelBitmap & (~0u << (firstLevel + 1));
+        if(larger == 0)
+            return 0;
+        firstLevel = LowestBit(larger);
+        bitmap = secondLevelBitmap[firstLevel];
+    }
+    return freeLists[firstLevel][LowestBit(bitmap)];
+}
         
 void* MemoryManager::malloc(size_t size)
 {
-    MemoryChunk *result = 0;
+    if(size > 0x80000000)
+        return 0;
+    size = size < ALIGNMENT ? ALIGNMENT : (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
     
-    for(MemoryChunk* chunk = first; chunk != 0 && result == 0; chunk = chunk->next)
-        if(chunk->size > size && !chunk->allocated)
-            result = chunk;
-        
+    SpinlockGuard guard(&lock);
+    MemoryChunk *result = FindFree(size);
+    if(result == 0 && Grow(size))
+        result = FindFree(size);
     if(result == 0)
         return 0;
+    RemoveFree(result);
     
-    if(result->size >= size + sizeof(MemoryChunk) + 1)
+    if(result->size >= size + sizeof(MemoryChunk) + ALIGNMENT)
     {
         MemoryChunk* temp = (MemoryChunk*)((size_t)result + sizeof(MemoryChunk) + size);
         
@@ -53,6 +201,7 @@ void* MemoryManager::malloc(size_t size)
         temp->next = result->next;
         if(temp->next != 0)
             temp->next->prev = temp;
+        InsertFree(temp);
         
         result->size = size;
         result->next = temp;
@@ -64,12 +213,17 @@ void* MemoryManager::malloc(size_t size)
 
 void MemoryManager::free(void* ptr)
 {
+    if(ptr == 0)
+        return;
+    
+    SpinlockGuard guard(&lock);
     MemoryChunk* chunk = (MemoryChunk*)((size_t)ptr - sizeof(MemoryChunk));
     
     chunk -> allocated = false;
     
     if(chunk->prev != 0 && !chunk->prev->allocated)
     {
+        RemoveFree(chunk->prev);
         chunk->prev->next = chunk->next;
         chunk->prev->size += chunk->size + sizeof(MemoryChunk);
         if(chunk->next != 0)
@@ -80,12 +234,14 @@ void MemoryManager::free(void* ptr)
     
     if(chunk->next != 0 && !chunk->next->allocated)
     {
+        RemoveFree(chunk->next);
         chunk->size += chunk->next->size + sizeof(MemoryChunk);
         chunk->next = chunk->next->next;
         if(chunk->next != 0)
             chunk->next->prev = chunk;
     }
     
+    InsertFree(chunk);
 }
 
 
@@ -121,6 +277,12 @@ void operator delete(void* ptr)
         myos::MemoryManager::activeMemoryManager->free(ptr);
 }
 
+void operator delete(void* ptr, unsigned size)
+{
+    if(myos::MemoryManager::activeMemoryManager != 0)
+        myos::MemoryManager::activeMemoryManager->free(ptr);
+}
+
 void operator delete[](void* ptr)
 {
     if(myos::MemoryManager::activeMemoryManager != 0)
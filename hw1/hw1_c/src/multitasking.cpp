@@ -1,8 +1,12 @@
 
 #include <multitasking.h>
+#include <synchronization.h>
+#include <fpu.h>
+#include <hardwarecommunication/apic.h>
 
 using namespace myos;
 using namespace myos::common;
+using namespace myos::hardwarecommunication;
 
 Task::Task(GlobalDescriptorTable *gdt, void entrypoint())
 {
@@ -20,196 +24,1577 @@ Task::Task(GlobalDescriptorTable *gdt, void entrypoint())
     cpustate->eip = (uint32_t)entrypoint;
     cpustate->cs = gdt->CodeSegmentSelector();
     cpustate->eflags = 0x202;
+
+    fpuState = (uint8_t *)(((uint32_t)fpuArea + 15) & ~15);
+    for (int i = 0; i < MAX_WAIT; i++)
+        waitEntries[i].target = 0;
+    sleepTimer.pending = false;
+    sleepTimer.data = this;
+    releaseTimer.pending = false;
+    releaseTimer.data = this;
+
+    statistics.runningTicks = 0;
+    statistics.readyTicks = 0;
+    statistics.blockedTicks = 0;
+    statistics.switches = 0;
+    statistics.voluntarySwitches = 0;
+    statistics.involuntarySwitches = 0;
+    statistics.started = false;
+}
+
+/**
+ * @brief Constructs a new Task object.
+ *
+ * @param esp The value of the stack pointer (esp) register.
+ */
+myos::Task::Task(uint32_t esp)
+{
+    cpustate = (CPUState *)(stack + 4096 - sizeof(CPUState));
+    CPUState *source = (CPUState *)esp;
+    *(cpustate) = *source;
+    cpustate->eax = 0;
+
+    fpuState = (uint8_t *)(((uint32_t)fpuArea + 15) & ~15);
+    for (int i = 0; i < MAX_WAIT; i++)
+        waitEntries[i].target = 0;
+    sleepTimer.pending = false;
+    sleepTimer.data = this;
+    releaseTimer.pending = false;
+    releaseTimer.data = this;
+
+    statistics.runningTicks = 0;
+    statistics.readyTicks = 0;
+    statistics.blockedTicks = 0;
+    statistics.switches = 0;
+    statistics.voluntarySwitches = 0;
+    statistics.involuntarySwitches = 0;
+    statistics.started = false;
+}
+
+void printfHex(uint8_t);
+
+int myos::Task::GetID()
+{
+    return id;
+}
+
+void myos::Task::SetPriority(int priority)
+{
+    this->priority = priority < 0 ? 0 : priority;
+}
+
+int myos::Task::GetPriority()
+{
+    return priority;
+}
+
+/**
+ * @return The priority the task is scheduled with: its own, or the one inherited through a mutex if higher.
+ */
+int myos::Task::EffectivePriority()
+{
+    return inheritedPriority > priority ? inheritedPriority : priority;
+}
+
+/**
+ * Sets the share of the CPU the task gets relative to other tasks under proportional-share scheduling.
+ *
+ * @param tickets The number of tickets, clamped to [1, 10000].
+ */
+void myos::Task::SetTickets(int tickets)
+{
+    if (tickets < 1)
+        tickets = 1;
+    if (tickets > 10000)
+        tickets = 10000;
+    this->tickets = tickets;
+}
+
+int myos::Task::GetTickets()
+{
+    return tickets;
+}
+
+TaskState myos::Task::GetState()
+{
+    return state;
+}
+
+/**
+ * Gives the task scripted input: its reads on the console return these lines instead of
+ * waiting for the keyboard, so a run does not depend on the timing of a user.
+ *
+ * @param input Newline-separated lines, zero-terminated. Must stay valid while the task runs.
+ */
+void myos::Task::SetInput(char *input)
+{
+    this->input = input;
+}
+
+/**
+ * Takes the next line of the scripted input, like Terminal::Read.
+ *
+ * @param buffer The buffer for the characters, not zero-terminated.
+ * @param size The size of the buffer.
+ * @return The number of characters read, 0 at the end of the script, -1 if the task has none.
+ */
+int myos::Task::ReadInput(char *buffer, int size)
+{
+    if (input == 0)
+        return -1;
+
+    int count = 0;
+    while (count < size && *input != '\0')
+    {
+        char c = *input++;
+        buffer[count++] = c;
+        if (c == '\n')
+            break;
+    }
+    return count;
+}
+
+/**
+ * Allocates memory from the arena of the task by moving a pointer. There is no free,
+ * the whole arena goes back to the heap when the task exits.
+ *
+ * @param size The size of the memory, at most 2 GiB.
+ * @return A pointer to the memory, or 0 if the size is too large or the heap is exhausted.
+ */
+void *myos::Task::Allocate(size_t size)
+{
+    if (size > 0x80000000)
+        return 0;
+    size = size < MemoryManager::ALIGNMENT ? MemoryManager::ALIGNMENT : (size + MemoryManager::ALIGNMENT - 1) & ~(MemoryManager::ALIGNMENT - 1);
+    if (arena == 0 || (size_t)(arena->end - arena->top) < size)
+    {
+        size_t header = (sizeof(ArenaChunk) + MemoryManager::ALIGNMENT - 1) & ~(MemoryManager::ALIGNMENT - 1);
+        size_t chunkSize = header + size < ARENA_CHUNK_SIZE ? ARENA_CHUNK_SIZE : header + size;
+        if (MemoryManager::activeMemoryManager == 0)
+            return 0;
+        ArenaChunk *chunk = (ArenaChunk *)MemoryManager::activeMemoryManager->malloc(chunkSize);
+        if (chunk == 0)
+            return 0;
+        chunk->top = (uint8_t *)chunk + header;
+        chunk->end = (uint8_t *)chunk + chunkSize;
+
+        // a chunk that is used up right away goes behind the current one, which may still have room
+        if (arena != 0 && chunkSize - header == size)
+        {
+            chunk->next = arena->next;
+            arena->next = chunk;
+        }
+        else
+        {
+            chunk->next = arena;
+            arena = chunk;
+        }
+        chunk->top += size;
+        return chunk->top - size;
+    }
+
+    arena->top += size;
+    return arena->top - size;
+}
+
+/**
+ * Returns all memory of task_alloc to the heap, called when the task exits.
+ */
+void myos::Task::ReleaseArena()
+{
+    if (MemoryManager::activeMemoryManager == 0)
+        return;
+    while (arena != 0)
+    {
+        ArenaChunk *chunk = arena;
+        arena = chunk->next;
+        MemoryManager::activeMemoryManager->free(chunk);
+    }
+}
+
+Task::~Task()
+{
+    ReleaseArena();
+}
+
+WaitQueue::WaitQueue()
+{
+    head = 0;
+}
+
+WaitQueue::~WaitQueue()
+{
+}
+
+/**
+ * Inserts a task behind the waiters with the same or a higher effective priority.
+ *
+ * @param task A pointer to the task.
+ */
+void myos::WaitQueue::Push(Task *task)
+{
+    Task **link = &head;
+    while (*link != 0 && (*link)->EffectivePriority() >= task->EffectivePriority())
+        link = &(*link)->nextWaiter;
+    task->nextWaiter = *link;
+    *link = task;
+    task->waitQueue = this;
+}
+
+/**
+ * Removes the first waiter.
+ *
+ * @return A pointer to the removed task, or 0 if the queue is empty.
+ */
+Task *myos::WaitQueue::Pop()
+{
+    Task *task = head;
+    if (task != 0)
+        Remove(task);
+    return task;
+}
+
+void myos::WaitQueue::Remove(Task *task)
+{
+    Task **link = &head;
+    while (*link != 0 && *link != task)
+        link = &(*link)->nextWaiter;
+    if (*link != 0)
+        *link = task->nextWaiter;
+    task->nextWaiter = 0;
+    task->waitQueue = 0;
+}
+
+Task *myos::WaitQueue::Front()
+{
+    return head;
+}
+
+bool myos::WaitQueue::IsEmpty()
+{
+    return head == 0;
+}
+
+SlabCache myos::Task::cache("task", sizeof(Task));
+
+/**
+ * Allocates memory for a Task from the task cache.
+ *
+ * @param size The size of the object.
+ * @return A pointer to the memory, or 0 if the heap is exhausted. Being declared throw(),
+ * a null result skips the constructor and new returns 0.
+ */
+void *myos::Task::operator new(size_t size) throw()
+{
+    return cache.Allocate();
+}
+
+/**
+ * Returns a Task to the task cache.
+ *
+ * @param ptr A pointer to the Task.
+ */
+void myos::Task::operator delete(void *ptr)
+{
+    cache.Free(ptr);
+}
+
+/**
+ * Marks a task as READY and hands it to the scheduler policy of the processor it last ran on,
+ * or to the deadline queue if the task is in the deadline class.
+ * A deadline task without budget left waits for its next period.
+ *
+ * @param task A pointer to the task.
+ */
+void myos::TaskManager::Enqueue(Task *task)
+{
+    SetState(task, TaskState::READY);
+    if (task->period == 0)
+    {
+        Processor *processor = &processors[task->processor];
+        processor->policy->Enqueue(task);
+        processor->numReady++;
+    }
+    else if (task->runtime == 0)
+    {
+        task->throttled = true;
+    }
+    else
+    {
+        EnqueueDeadline(task);
+    }
+}
+
+/**
+ * Re-sorts a task whose effective priority changed: a READY task within the run queue of its processor,
+ * a BLOCKED task within the wait queue it sleeps in. A running task picks the change up on its next enqueue.
+ *
+ * @param task A pointer to the task.
+ */
+void myos::TaskManager::Reprioritize(Task *task)
+{
+    if (task->state == TaskState::READY && task->period == 0)
+    {
+        processors[task->processor].policy->Reprioritize(task);
+    }
+    else if (task->state == TaskState::BLOCKED && task->waitQueue != 0)
+    {
+        WaitQueue *queue = task->waitQueue;
+        queue->Remove(task);
+        queue->Push(task);
+    }
+}
+
+/**
+ * Makes a task that was taken out of a futex or mutex wait queue READY.
+ *
+ * @param task A pointer to the task.
+ * @param result The result of its wait, returned in eax unless the task restarts its syscall.
+ */
+void myos::TaskManager::Unblock(Task *task, uint32_t result)
+{
+    timers.Cancel(&task->sleepTimer);
+    task->futexAddress = 0;
+    task->blockedOn = 0;
+    if (!task->restartSyscall)
+        task->cpustate->eax = result;
+    task->restartSyscall = false;
+    Enqueue(task);
+}
+
+/**
+ * Blocks a task in the futex wait queue of a word.
+ *
+ * @param task A pointer to the task, its CPU state must already be saved.
+ * @param address The address of the word.
+ * @param timeoutMs The longest time to sleep in milliseconds, 0 for no timeout.
+ */
+void myos::TaskManager::SleepOn(Task *task, volatile uint32_t *address, uint32_t timeoutMs)
+{
+    task->futexAddress = address;
+    futexQueues[((uint32_t)address >> 2) % FUTEX_BUCKETS].Push(task);
+    if (timeoutMs != 0)
+        timers.Add(&task->sleepTimer, timers.Now() + MillisecondsToTicks(timeoutMs));
+    SetState(task, TaskState::BLOCKED);
+}
+
+/**
+ * Makes a task the owner of a free mutex.
+ *
+ * @param task A pointer to the new owner.
+ * @param mutex A pointer to the mutex.
+ */
+void myos::TaskManager::Acquire(Task *task, Mutex *mutex)
+{
+    mutex->owner = task;
+    mutex->nextHeld = task->heldMutexes;
+    task->heldMutexes = mutex;
+}
+
+/**
+ * Takes a mutex from its owner and passes it on to the first waiter, which becomes READY.
+ * The old owner keeps only the priority inherited through the mutexes it still holds.
+ *
+ * @param mutex A pointer to the mutex.
+ * @return A pointer to the new owner, or 0 if no task was waiting and the mutex is free.
+ */
+Task *myos::TaskManager::HandOff(Mutex *mutex)
+{
+    Task *owner = mutex->owner;
+    Mutex **link = &owner->heldMutexes;
+    while (*link != mutex)
+        link = &(*link)->nextHeld;
+    *link = mutex->nextHeld;
+    mutex->owner = 0;
+    mutex->nextHeld = 0;
+    UpdateInheritedPriority(owner);
+
+    Task *next = mutex->waiters.Pop();
+    if (next == 0)
+        return 0;
+    Acquire(next, mutex);
+    UpdateInheritedPriority(next);
+    Unblock(next, 0);
+    return next;
+}
+
+/**
+ * Recomputes the priority a task inherits from the first waiter of each mutex it holds.
+ *
+ * @param task A pointer to the task.
+ * @return True if the inherited priority changed.
+ */
+bool myos::TaskManager::UpdateInheritedPriority(Task *task)
+{
+    int inherited = -1;
+    for (Mutex *mutex = task->heldMutexes; mutex != 0; mutex = mutex->nextHeld)
+    {
+        Task *waiter = mutex->waiters.Front();
+        if (waiter != 0 && waiter->EffectivePriority() > inherited)
+            inherited = waiter->EffectivePriority();
+    }
+    if (inherited == task->inheritedPriority)
+        return false;
+    task->inheritedPriority = inherited;
+    return true;
+}
+
+/**
+ * Passes the priority of the waiters of a mutex on to its owner, and from there along the chain
+ * of mutexes the owners are blocked on, until a priority does not change.
+ *
+ * @param mutex A pointer to the mutex that got a new waiter.
+ */
+void myos::TaskManager::Inherit(Mutex *mutex)
+{
+    for (int depth = 0; mutex != 0 && depth < MAX_INHERITANCE_DEPTH; depth++)
+    {
+        Task *owner = mutex->owner;
+        if (owner == 0 || !UpdateInheritedPriority(owner))
+            break;
+        Reprioritize(owner);
+        mutex = owner->blockedOn;
+    }
+}
+
+/**
+ * Inserts a deadline task into the deadline queue, behind the tasks with the same or an earlier deadline.
+ *
+ * @param task A pointer to the task.
+ */
+void myos::TaskManager::EnqueueDeadline(Task *task)
+{
+    Task **link = &deadlineQueue;
+    while (*link != 0 && (int32_t)((*link)->deadline - task->deadline) <= 0)
+        link = &(*link)->nextReady;
+    task->nextReady = *link;
+    *link = task;
+}
+
+/**
+ * Starts the next period of a deadline task: the budget is refilled and the deadline moves one period ahead.
+ * A task that was throttled for using up its budget is runnable again.
+ *
+ * @param task A pointer to the task.
+ */
+void myos::TaskManager::Release(Task *task)
+{
+    task->runtime = task->budget;
+    task->deadline = clockCounter + task->period;
+    timers.Add(&task->releaseTimer, timers.Now() + task->period);
+
+    if (task->state != TaskState::READY)
+        return;
+    if (task->throttled)
+    {
+        task->throttled = false;
+    }
+    else
+    {
+        // the deadline changed, so the task moves within the queue
+        Task **link = &deadlineQueue;
+        while (*link != task)
+            link = &(*link)->nextReady;
+        *link = task->nextReady;
+    }
+    EnqueueDeadline(task);
+}
+
+/**
+ * Charges a clock tick to the running deadline task.
+ *
+ * @param running A pointer to the running task.
+ * @return True if the task has used up its budget for this period.
+ */
+bool myos::TaskManager::DeadlineTick(Task *running)
+{
+    if (running->runtime > 0)
+        running->runtime--;
+    return running->runtime == 0;
+}
+
+/**
+ * Blocks a task until the given tasks have exited.
+ * Tasks that have already exited are reaped right away, PIDs that do not exist count as exited.
+ * The PID of the exited task that ended the wait is returned to the task in eax,
+ * or -1 if n is larger than Task::MAX_WAIT, in which case nothing is waited for.
+ *
+ * @param task A pointer to the waiting task, its CPU state must already be saved.
+ * @param pids The PIDs to wait for.
+ * @param n The number of PIDs, at most Task::MAX_WAIT.
+ * @param any If true, the first exit ends the wait, otherwise all tasks must exit.
+ * @return True if the task is now BLOCKED, false if the wait is already over.
+ */
+bool myos::TaskManager::Wait(Task *task, int *pids, int n, bool any)
+{
+    if (n < 0 || n > Task::MAX_WAIT)
+    {
+        task->cpustate->eax = -1;
+        return false;
+    }
+
+    int done = -1;
+    task->waitCount = 0;
+    for (int i = 0; i < n; i++)
+    {
+        Task *target = GetTask(pids[i]);
+        if (target == 0 || target == task || target->state == TaskState::EXITED)
+        {
+            if (target != 0 && target != task)
+                Reap(target);
+            done = pids[i];
+            if (any)
+                break;
+            continue;
+        }
+
+        WaitQueueEntry *entry = &task->waitEntries[i];
+        entry->task = task;
+        entry->target = target;
+        entry->prev = 0;
+        entry->next = target->waiters;
+        if (target->waiters != 0)
+            target->waiters->prev = entry;
+        target->waiters = entry;
+        task->waitCount++;
+    }
+
+    if (task->waitCount == 0 || (any && done >= 0))
+    {
+        CancelWait(task);
+        task->cpustate->eax = done;
+        return false;
+    }
+
+    if (any)
+        task->waitCount = 1;
+    SetState(task, TaskState::BLOCKED);
+    return true;
+}
+
+/**
+ * Removes a task from all waiter lists it is still linked into.
+ *
+ * @param task A pointer to the waiting task.
+ */
+void myos::TaskManager::CancelWait(Task *task)
+{
+    for (int i = 0; i < Task::MAX_WAIT; i++)
+    {
+        WaitQueueEntry *entry = &task->waitEntries[i];
+        if (entry->target == 0)
+            continue;
+        if (entry->prev != 0)
+            entry->prev->next = entry->next;
+        else
+            entry->target->waiters = entry->next;
+        if (entry->next != 0)
+            entry->next->prev = entry->prev;
+        entry->target = 0;
+    }
+    task->waitCount = 0;
+}
+
+/**
+ * Wakes the tasks in the waiter list of an exiting task.
+ * A waiter becomes READY once the last task it waits for has exited.
+ *
+ * @param target A pointer to the exiting task.
+ * @return True if at least one task was waiting.
+ */
+bool myos::TaskManager::WakeWaiters(Task *target)
+{
+    WaitQueueEntry *first = target->waiters;
+    target->waiters = 0;
+
+    // Detach the whole list first, so CancelWait never touches it
+    for (WaitQueueEntry *entry = first; entry != 0; entry = entry->next)
+        entry->target = 0;
+
+    WaitQueueEntry *entry = first;
+    while (entry != 0)
+    {
+        WaitQueueEntry *next = entry->next;
+        Task *waiter = entry->task;
+
+        if (waiter->state == TaskState::BLOCKED && --waiter->waitCount == 0)
+        {
+            CancelWait(waiter);
+            waiter->cpustate->eax = target->id;
+            Enqueue(waiter);
+        }
+        entry = next;
+    }
+    return first != 0;
+}
+
+/**
+ * Converts a time to clock ticks, rounding up.
+ *
+ * @param ms The time in milliseconds.
+ * @return The time in clock ticks.
+ */
+uint32_t myos::TaskManager::MillisecondsToTicks(uint32_t ms)
+{
+    return (ms / 1000) * tickRate + ((ms % 1000) * tickRate + 999) / 1000;
+}
+
+/**
+ * Advances the timer wheel by one clock tick, makes the tasks whose sleep or futex wait ended READY
+ * and starts the next period of deadline tasks.
+ */
+void myos::TaskManager::Tick()
+{
+    clockCounter++;
+    TimerEntry *entry = timers.Tick();
+    while (entry != 0)
+    {
+        TimerEntry *next = entry->next; // Release re-arms the entry
+        Task *task = (Task *)entry->data;
+        if (entry == &task->releaseTimer)
+        {
+            Release(task);
+        }
+        else if (task->state == TaskState::SLEEPING)
+        {
+            Enqueue(task);
+        }
+        else if (task->state == TaskState::BLOCKED && task->futexAddress != 0)
+        {
+            task->waitQueue->Remove(task);
+            Unblock(task, (uint32_t)Futex::TIMED_OUT);
+        }
+        entry = next;
+    }
+}
+
+/**
+ * Doubles the size of the task table.
+ *
+ * @return True if the table was grown, false if the heap is exhausted.
+ */
+bool myos::TaskManager::Grow()
+{
+    int newCapacity = capacity == 0 ? 16 : 2 * capacity;
+    Task **newTasks = new Task *[newCapacity];
+    int *newFreePids = new int[newCapacity];
+    if (newTasks == 0 || newFreePids == 0)
+    {
+        if (newTasks != 0)
+            delete[] newTasks;
+        if (newFreePids != 0)
+            delete[] newFreePids;
+        return false;
+    }
+
+    for (int i = 0; i < newCapacity; i++)
+        newTasks[i] = i < numTasks ? tasks[i] : 0;
+    for (int i = 0; i < numFreePids; i++)
+        newFreePids[i] = freePids[i];
+
+    if (capacity != 0)
+    {
+        delete[] tasks;
+        delete[] freePids;
+    }
+    tasks = newTasks;
+    freePids = newFreePids;
+    capacity = newCapacity;
+    return true;
+}
+
+/**
+ * Removes an exited task from the table, releases its PID and its memory.
+ * The memory of the task whose stack is in use is only released on the next switch of its processor.
+ *
+ * @param task A pointer to the exited task.
+ */
+void myos::TaskManager::Reap(Task *task)
+{
+    tasks[task->id] = 0;
+    freePids[numFreePids++] = task->id;
+    Processor *processor = CurrentProcessor();
+    if (task->id == processor->currentTask)
+        processor->reapedTask = task;
+    else
+        delete task;
+}
+
+/**
+ * Marks a task as EXITED, wakes its waiters and reaps what no one can wait for anymore:
+ * zombie children of the task, and the task itself if it was waited for or has no living parent.
+ *
+ * @param task A pointer to the exiting task.
+ */
+void myos::TaskManager::ExitTask(Task *task)
+{
+    // mutexes held by an exiting task go to their waiters instead of staying locked forever
+    while (task->heldMutexes != 0)
+        HandOff(task->heldMutexes);
+    // the Task object may be reused, it must not look like the owner of any FPU registers
+    for (int i = 0; i < numProcessors; i++)
+        if (processors[i].fpuOwner == task)
+            processors[i].fpuOwner = 0;
+
+    SetState(task, TaskState::EXITED);
+    task->priority = -1;
+    task->ReleaseArena();
+    if (task->period != 0)
+    {
+        timers.Cancel(&task->releaseTimer);
+        deadlineUtilization -= task->utilization;
+        task->period = 0;
+    }
+
+    for (int i = 0; i < numTasks; i++)
+    {
+        if (tasks[i] == 0 || tasks[i]->parentPid != task->id)
+            continue;
+        if (tasks[i]->state == TaskState::EXITED)
+            Reap(tasks[i]);
+        else
+            tasks[i]->parentPid = -1;
+    }
+
+    Task *parent = GetTask(task->parentPid);
+    bool orphan = parent == 0 || parent->state == TaskState::EXITED;
+    if (WakeWaiters(task) || orphan)
+        Reap(task);
+}
+
+/**
+ * Changes the state of a task and charges the time spent in the old state to its statistics.
+ *
+ * @param task A pointer to the task.
+ * @param state The new state.
+ */
+void myos::TaskManager::SetState(Task *task, TaskState state)
+{
+    uint32_t ticks = clockCounter - task->stateSince;
+    switch (task->state)
+    {
+    case TaskState::RUNNING:
+        task->statistics.runningTicks += ticks;
+        task->statistics.switches++;
+        break;
+    case TaskState::READY:
+        task->statistics.readyTicks += ticks;
+        break;
+    case TaskState::BLOCKED:
+    case TaskState::SLEEPING:
+        task->statistics.blockedTicks += ticks;
+        break;
+    default:
+        break;
+    }
+    if (state == TaskState::RUNNING && !task->statistics.started)
+    {
+        task->statistics.firstRunTick = clockCounter;
+        task->statistics.started = true;
+    }
+    else if (state == TaskState::EXITED)
+    {
+        task->statistics.exitTick = clockCounter;
+    }
+    task->state = state;
+    task->stateSince = clockCounter;
+}
+
+/**
+ * Finds the processor executing the code.
+ *
+ * @return A pointer to the scheduling state of the processor.
+ */
+Processor *myos::TaskManager::CurrentProcessor()
+{
+    if (numProcessors == 1)
+        return &processors[0];
+    return &processors[processorOfApic[LocalAPIC::ID()]];
+}
+
+/**
+ * Takes a READY task from the run queue of the busiest other processor.
+ *
+ * @param processor A pointer to the processor that ran out of work.
+ * @return The stolen task, now belonging to the processor, or 0 if no other processor has a waiting task.
+ */
+Task *myos::TaskManager::Steal(Processor *processor)
+{
+    Processor *victim = 0;
+    for (int i = 0; i < numProcessors; i++)
+        if (&processors[i] != processor && processors[i].numReady > 0 &&
+            (victim == 0 || processors[i].numReady > victim->numReady))
+            victim = &processors[i];
+    if (victim == 0)
+        return 0;
+
+    Task *task = victim->policy->Dequeue();
+    if (task == 0)
+        return 0;
+    victim->numReady--;
+    task->processor = processor - processors;
+    return task;
+}
+
+/**
+ * @return The processor with the fewest running and READY tasks, where new tasks are placed.
+ */
+Processor *myos::TaskManager::LeastLoaded()
+{
+    Processor *best = &processors[0];
+    int bestLoad = best->numReady + (best->currentTask >= 0 ? 1 : 0);
+    for (int i = 1; i < numProcessors; i++)
+    {
+        int load = processors[i].numReady + (processors[i].currentTask >= 0 ? 1 : 0);
+        if (load < bestLoad)
+        {
+            best = &processors[i];
+            bestLoad = load;
+        }
+    }
+    return best;
+}
+
+/**
+ * Finds the next task to be executed on a processor.
+ * The deadline task with the earliest deadline goes first, otherwise
+ * the scheduler policy of the processor selects the task and its time slice.
+ * A processor without READY tasks of its own steals one from another processor.
+ * The selected task is marked as RUNNING.
+ * If no task is ready, currentTask is set to -1 and the idle context runs instead.
+ *
+ * @param processor A pointer to the processor.
+ */
+void myos::TaskManager::FindNextTask(Processor *processor)
+{
+    Task *task;
+    if (deadlineQueue != 0)
+    {
+        task = deadlineQueue;
+        deadlineQueue = task->nextReady;
+        task->processor = processor - processors;
+    }
+    else
+    {
+        task = processor->policy->Dequeue();
+        if (task != 0)
+            processor->numReady--;
+        else
+            task = Steal(processor);
+    }
+
+    if (task == 0)
+    {
+        processor->currentTask = -1;
+        return;
+    }
+    processor->currentTask = task->id;
+    SetState(task, TaskState::RUNNING);
+    task->timeSlice = task->period != 0 ? task->runtime : processor->policy->TimeSlice(task);
+}
+
+TaskManager *TaskManager::activeTaskManager = 0;
+
+TaskManager::TaskManager()
+{
+    activeTaskManager = this;
+    tasks = 0;
+    freePids = 0;
+    capacity = 0;
+    numTasks = 0;
+    numFreePids = 0;
+    for (int i = 0; i < NUM_PRIORITIES; i++)
+        quantum[i] = DEFAULT_QUANTUM;
+    for (int i = 0; i < 256; i++)
+        processorOfApic[i] = 0;
+
+    numProcessors = 1;
+    Processor *processor = &processors[0];
+    processor->apicId = 0;
+    processor->currentTask = -1;
+    processor->reapedTask = 0;
+    processor->idleTask = 0;
+    processor->idleState = 0;
+    processor->idling = false;
+    processor->idleTicks = 0;
+    processor->policy = &defaultPolicy;
+    processor->numReady = 0;
+    processor->fpuOwner = 0;
+    defaultPolicy.taskManager = this;
+}
+
+/**
+ * Replaces the scheduler policy of the boot processor, before further processors are added.
+ * The READY tasks of the old policy are moved to the new one and the old policy is deleted.
+ *
+ * @param policy A pointer to the new policy, allocated with new. The task manager owns it from now on.
+ */
+void myos::TaskManager::SetPolicy(SchedulerPolicy *policy)
+{
+    SpinlockGuard guard(&lock);
+    Processor *processor = &processors[0];
+    SchedulerPolicy *old = processor->policy;
+    policy->taskManager = this;
+    for (Task *task = old->Dequeue(); task != 0; task = old->Dequeue())
+        policy->Enqueue(task);
+    processor->policy = policy;
+    if (old != &defaultPolicy)
+        delete old;
+}
+
+/**
+ * Adds a processor that shares the tasks with the others.
+ * Its run queue is a new scheduler policy of the same kind as the one of the boot processor.
+ * Called on the new processor itself, before it takes interrupts.
+ *
+ * @param apicId The local APIC ID of the processor.
+ * @param idleTask The task the processor runs when no task is ready.
+ * @return The index of the processor, or -1 if there are too many or the heap is exhausted.
+ */
+int myos::TaskManager::AddProcessor(uint8_t apicId, Task *idleTask)
+{
+    SpinlockGuard guard(&lock);
+    if (numProcessors >= MAX_PROCESSORS || idleTask == 0)
+        return -1;
+    SchedulerPolicy *policy = processors[0].policy->Create();
+    if (policy == 0)
+        return -1;
+    policy->taskManager = this;
+
+    int index = numProcessors;
+    Processor *processor = &processors[index];
+    processor->apicId = apicId;
+    processor->currentTask = -1;
+    processor->reapedTask = 0;
+    processor->idleTask = idleTask;
+    processor->idleState = idleTask->cpustate;
+    processor->idling = false;
+    processor->idleTicks = 0;
+    processor->policy = policy;
+    processor->numReady = 0;
+    processor->fpuOwner = 0;
+    idleTask->state = TaskState::READY;
+
+    processorOfApic[apicId] = index;
+    numProcessors++;
+    return index;
+}
+
+int myos::TaskManager::GetNumProcessors()
+{
+    return numProcessors;
+}
+
+TaskManager::~TaskManager()
+{
+    for (int i = 0; i < numProcessors; i++)
+        if (processors[i].policy != &defaultPolicy)
+            delete processors[i].policy;
+}
+
+/**
+ * Adds a task to the task manager.
+ * The task reuses a PID released by a reaped task, or gets a new one if none is free,
+ * and becomes a child of the current task.
+ *
+ * @param task A pointer to the task to be added.
+ * @return True if the task was successfully added, false otherwise.
+ */
+bool myos::TaskManager::AddTask(Task *task)
+{
+    SpinlockGuard guard(&lock);
+    return Insert(task);
+}
+
+/**
+ * Adds a task to the task table and, if it is READY, to the run queue of the least loaded processor.
+ *
+ * @param task A pointer to the task to be added.
+ * @return True if the task was successfully added, false otherwise.
+ */
+bool myos::TaskManager::Insert(Task *task)
+{
+    if (task == 0)
+        return false;
+
+    int pid;
+    if (numFreePids > 0)
+    {
+        pid = freePids[--numFreePids];
+    }
+    else
+    {
+        if (numTasks >= capacity && !Grow())
+            return false;
+        pid = numTasks++;
+    }
+
+    tasks[pid] = task;
+    task->id = pid;
+    task->parentPid = CurrentProcessor()->currentTask;
+    task->stateSince = clockCounter;
+    task->statistics.arrivalTick = clockCounter;
+    if (task->state == TaskState::READY)
+    {
+        Processor *processor = LeastLoaded();
+        task->processor = processor - processors;
+        processor->policy->Enqueue(task);
+        processor->numReady++;
+    }
+    return true;
 }
 
+void printf(char *);
+void printfHex32(uint32_t);
+
 /**
- * @brief Constructs a new Task object.
+ * Frees the exited task whose stack was still in use on the previous switch of a processor.
  *
- * @param esp The value of the stack pointer (esp) register.
+ * @param processor A pointer to the processor.
  */
-myos::Task::Task(uint32_t esp)
+void myos::TaskManager::FreeReapedTask(Processor *processor)
 {
-    cpustate = (CPUState *)(stack + 4096 - sizeof(CPUState));
-    CPUState *source = (CPUState *)esp;
-    *(cpustate) = *source;
-    cpustate->eax = 0;
+    if (processor->reapedTask != 0)
+    {
+        delete processor->reapedTask;
+        processor->reapedTask = 0;
+    }
 }
 
-void printfHex(uint8_t);
+/**
+ * Switches a processor to its next task.
+ * The previous task goes back to the scheduler policy if it is still RUNNING.
+ * If no task is ready, the idle task runs. Without an idle task,
+ * the context interrupted before the first task switch (kernelMain) is resumed instead.
+ * The FPU state of the previous task is saved if it used the FPU since it was switched in,
+ * the next task only gets its state loaded when it uses the FPU, see LoadFloatingPointState.
+ *
+ * @param processor A pointer to the processor.
+ * @param task A pointer to the previous task, its CPU state must already be saved, or 0 if the idle context ran.
+ * @param cpustate A pointer to the CPU state of the idle context if it ran.
+ * @return A pointer to the CPU state of the next task.
+ */
+CPUState *myos::TaskManager::Switch(Processor *processor, Task *task, CPUState *cpustate)
+{
+    // TS is only clear while the owner of the registers runs
+    if (task != 0 && processor->fpuOwner == task && !FloatingPointUnit::IsTaskSwitched())
+        FloatingPointUnit::Save(task->fpuState);
 
-int myos::Task::GetID()
+    if (task != 0)
+    {
+        if (task->state == TaskState::BLOCKED || task->state == TaskState::SLEEPING)
+        {
+            if (task->period == 0)
+                processor->policy->Block(task);
+        }
+        else if (task->state == TaskState::RUNNING)
+        {
+            Enqueue(task);
+        }
+    }
+    else if (processor->idling || processor->idleTask == 0)
+    {
+        processor->idleState = cpustate;
+    }
+
+    FindNextTask(processor);
+
+    processor->idling = processor->currentTask < 0;
+    if (processor->idling)
+    {
+        FloatingPointUnit::SetTaskSwitched();
+        return processor->idleState;
+    }
+
+    Task *next = tasks[processor->currentTask];
+    // the registers still hold the state of the next task if no other task used the FPU meanwhile
+    if (processor->fpuOwner == next && next->fpuProcessor == processor - processors)
+        FloatingPointUnit::ClearTaskSwitched();
+    else
+        FloatingPointUnit::SetTaskSwitched();
+    return next->cpustate;
+}
+
+/**
+ * @brief Preempts the running task when the scheduler decides so, called on every timer interrupt of a processor.
+ * Only the timer of the boot processor advances the clock.
+ * Syscalls have their own entry points and never count as a tick.
+ *
+ * @param cpustate A pointer to the CPU state.
+ * @return CPUState* A pointer to the CPU state of the next scheduled task.
+ */
+CPUState *TaskManager::Schedule(CPUState *cpustate)
 {
-    return id;
+    SpinlockGuard guard(&lock);
+    Processor *processor = CurrentProcessor();
+    if (processor == &processors[0])
+        Tick();
+    if (processor->idling)
+        processor->idleTicks++;
+
+    Task *running = processor->currentTask >= 0 ? tasks[processor->currentTask] : 0;
+    bool preempt;
+    if (running != 0 && running->period != 0)
+    {
+        processor->policy->Tick(0);
+        preempt = DeadlineTick(running);
+    }
+    else
+    {
+        preempt = processor->policy->Tick(running);
+    }
+
+    // deadline tasks run ahead of all other tasks, earliest deadline first
+    if (running != 0 && deadlineQueue != 0 &&
+        (running->period == 0 || (int32_t)(deadlineQueue->deadline - running->deadline) < 0))
+        preempt = true;
+
+    FreeReapedTask(processor);
+
+    if (waitingEnter)
+    {
+        return cpustate;
+    }
+
+    if (numTasks <= 0)
+        return cpustate;
+
+    if (running != 0)
+    {
+        if (!preempt)
+            return cpustate;
+        running->cpustate = cpustate;
+        running->statistics.involuntarySwitches++;
+    }
+    return Switch(processor, running, cpustate);
 }
 
-void myos::Task::SetPriority(int priority)
+/**
+ * Saves the CPU state of the task making a syscall that may switch tasks.
+ *
+ * @param processor A pointer to the processor executing the syscall.
+ * @param cpustate A pointer to the CPU state of the caller.
+ * @return A pointer to the current task, or 0 if the idle context made the call.
+ */
+Task *myos::TaskManager::EnterSyscall(Processor *processor, CPUState *cpustate)
 {
-    this->priority = priority < 0 ? 0 : priority;
+    FreeReapedTask(processor);
+    if (processor->currentTask < 0)
+        return 0;
+    Task *task = tasks[processor->currentTask];
+    task->cpustate = cpustate;
+    task->statistics.voluntarySwitches++;
+    return task;
 }
 
-int myos::Task::GetPriority()
+/**
+ * Gives up the CPU. From the idle context, switches to a task that has become ready.
+ *
+ * @param cpustate A pointer to the CPU state of the caller.
+ * @return A pointer to the CPU state of the next task.
+ */
+CPUState *myos::TaskManager::Yield(CPUState *cpustate)
 {
-    return priority;
+    SpinlockGuard guard(&lock);
+    Processor *processor = CurrentProcessor();
+    Task *task = EnterSyscall(processor, cpustate);
+    if (numTasks <= 0)
+        return cpustate;
+    return Switch(processor, task, cpustate);
 }
 
-TaskState myos::Task::GetState()
+/**
+ * Ends the current task and switches to the next one.
+ *
+ * @param cpustate A pointer to the CPU state of the caller.
+ * @return A pointer to the CPU state of the next task.
+ */
+CPUState *myos::TaskManager::Exit(CPUState *cpustate)
 {
-    return state;
+    SpinlockGuard guard(&lock);
+    Processor *processor = CurrentProcessor();
+    Task *task = EnterSyscall(processor, cpustate);
+    if (task == 0)
+        return cpustate;
+    ExitTask(task);
+    return Switch(processor, task, cpustate);
 }
 
-Task::~Task()
+/**
+ * Blocks the current task until the given tasks have exited, see Wait.
+ * The caller keeps running if the wait is already over.
+ *
+ * @param cpustate A pointer to the CPU state of the caller.
+ * @param pids The PIDs to wait for.
+ * @param n The number of PIDs.
+ * @param any If true, the first exit ends the wait, otherwise all tasks must exit.
+ * @return A pointer to the CPU state of the next task.
+ */
+CPUState *myos::TaskManager::WaitPids(CPUState *cpustate, int *pids, int n, bool any)
 {
+    SpinlockGuard guard(&lock);
+    Processor *processor = CurrentProcessor();
+    Task *task = EnterSyscall(processor, cpustate);
+    if (task == 0 || !Wait(task, pids, n, any))
+        return cpustate;
+    return Switch(processor, task, cpustate);
 }
 
 /**
- * Finds the next task to be executed in the task manager.
- * The task is selected based on its state and waiting process.
- * If a task is in the READY state, it is selected as the next task.
- * If a task is in the BLOCKED state and the process it is waiting for has exited,
- * it is also selected as the next task.
- * The selected task is marked as RUNNING.
+ * Puts the current task to sleep for at least the given time.
+ * The time is rounded up to whole clock ticks, the caller keeps running if it is 0.
+ *
+ * @param cpustate A pointer to the CPU state of the caller.
+ * @param ms The time to sleep in milliseconds.
+ * @return A pointer to the CPU state of the next task.
+ */
+CPUState *myos::TaskManager::Sleep(CPUState *cpustate, uint32_t ms)
+{
+    SpinlockGuard guard(&lock);
+    Processor *processor = CurrentProcessor();
+    cpustate->eax = 0;
+    Task *task = EnterSyscall(processor, cpustate);
+    if (task == 0 || ms == 0)
+        return cpustate;
+
+    timers.Add(&task->sleepTimer, timers.Now() + MillisecondsToTicks(ms));
+    SetState(task, TaskState::SLEEPING);
+    return Switch(processor, task, cpustate);
+}
+
+/**
+ * Puts the current task to sleep while a word holds a value, until FutexWake is called for the word.
+ * The comparison and going to sleep happen under the scheduler lock, so no wakeup is lost in between.
+ * The result is returned in eax: 0 if woken, Futex::AGAIN if the word did not hold the value,
+ * Futex::TIMED_OUT if the timeout passed or the idle context made the call.
+ *
+ * @param cpustate A pointer to the CPU state of the caller.
+ * @param address The address of the word.
+ * @param value The value the caller expects in the word.
+ * @param timeoutMs The longest time to sleep in milliseconds, 0 for no timeout.
+ * @return A pointer to the CPU state of the next task.
  */
-void myos::TaskManager::FindNextTask()
+CPUState *myos::TaskManager::FutexWait(CPUState *cpustate, volatile uint32_t *address, uint32_t value, uint32_t timeoutMs)
 {
-    if (checkPriority)
+    SpinlockGuard guard(&lock);
+    Processor *processor = CurrentProcessor();
+    if (processor->currentTask < 0)
     {
-        int selected = currentTask;
-        int priority = tasks[currentTask]->priority;
-        for (int i = 0; i < numTasks; i++)
-        {
-            if (tasks[i]->state == TaskState::READY)
-            {
-                if (tasks[i]->priority > priority)
-                {
-                    selected = i;
-                    priority = tasks[i]->priority;
-                }
-            }
-        }
-        currentTask = selected;
-        tasks[currentTask]->state = TaskState::RUNNING;
-        return;
+        cpustate->eax = (uint32_t)Futex::TIMED_OUT;
+        return cpustate;
     }
-    while (true)
+    if (*address != value)
     {
-        if (++currentTask >= numTasks)
-            currentTask %= numTasks;
+        cpustate->eax = (uint32_t)Futex::AGAIN;
+        return cpustate;
+    }
 
-        if (tasks[currentTask]->state == TaskState::READY)
-            break;
+    Task *task = EnterSyscall(processor, cpustate);
+    cpustate->eax = 0;
+    SleepOn(task, address, timeoutMs);
+    return Switch(processor, task, cpustate);
+}
 
-        if (tasks[currentTask]->state == TaskState::BLOCKED &&
-            tasks[tasks[currentTask]->waitingPid]->state == TaskState::EXITED)
-            break;
+/**
+ * Lets a syscall that cannot complete yet block: the current task sleeps like in FutexWait
+ * and then executes the same syscall again, with the same registers.
+ * If the word no longer holds the value, the syscall runs again right away.
+ * From the idle context the syscall fails with -1 instead.
+ *
+ * @param cpustate A pointer to the CPU state of the caller, eax still holding the syscall number.
+ * @param address The address of the word.
+ * @param value The value the syscall found in the word.
+ * @return A pointer to the CPU state of the next task.
+ */
+CPUState *myos::TaskManager::WaitAndRestart(CPUState *cpustate, volatile uint32_t *address, uint32_t value)
+{
+    SpinlockGuard guard(&lock);
+    Processor *processor = CurrentProcessor();
+    if (processor->currentTask < 0)
+    {
+        cpustate->eax = (uint32_t)-1;
+        return cpustate;
     }
-    tasks[currentTask]->state = TaskState::RUNNING;
+
+    cpustate->eip -= 2; // back to the int $0x80 instruction
+    if (*address != value)
+        return cpustate;
+
+    Task *task = EnterSyscall(processor, cpustate);
+    task->restartSyscall = true;
+    SleepOn(task, address, 0);
+    return Switch(processor, task, cpustate);
 }
 
-TaskManager::TaskManager()
+/**
+ * Wakes tasks sleeping in FutexWait on a word, highest priority first.
+ * Never switches tasks, so interrupt handlers may call it.
+ *
+ * @param address The address of the word.
+ * @param n The most tasks to wake.
+ * @return The number of tasks woken.
+ */
+int myos::TaskManager::FutexWake(volatile uint32_t *address, int n)
 {
-    numTasks = 0;
-    currentTask = -1;
+    SpinlockGuard guard(&lock);
+    WaitQueue *queue = &futexQueues[((uint32_t)address >> 2) % FUTEX_BUCKETS];
+    int woken = 0;
+    Task *task = queue->Front();
+    while (task != 0 && woken < n)
+    {
+        Task *next = task->nextWaiter;
+        if (task->futexAddress == address)
+        {
+            queue->Remove(task);
+            Unblock(task, 0);
+            woken++;
+        }
+        task = next;
+    }
+    return woken;
 }
 
-TaskManager::~TaskManager()
+/**
+ * Takes a mutex for the current task. If another task owns it, the current task sleeps
+ * until the mutex is handed to it, and the owner inherits its priority meanwhile.
+ * Returns 0 in eax, or -1 if the caller already owns the mutex or is the idle context.
+ *
+ * @param cpustate A pointer to the CPU state of the caller.
+ * @param mutex A pointer to the mutex.
+ * @return A pointer to the CPU state of the next task.
+ */
+CPUState *myos::TaskManager::LockMutex(CPUState *cpustate, Mutex *mutex)
 {
+    SpinlockGuard guard(&lock);
+    Processor *processor = CurrentProcessor();
+    Task *task = CurrentTask();
+    cpustate->eax = 0;
+    if (task == 0 || mutex->owner == task)
+    {
+        cpustate->eax = (uint32_t)-1;
+        return cpustate;
+    }
+    if (mutex->owner == 0)
+    {
+        Acquire(task, mutex);
+        return cpustate;
+    }
+
+    EnterSyscall(processor, cpustate);
+    task->blockedOn = mutex;
+    mutex->waiters.Push(task);
+    SetState(task, TaskState::BLOCKED);
+    Inherit(mutex);
+    return Switch(processor, task, cpustate);
 }
 
 /**
- * Adds a task to the task manager.
+ * Takes a mutex for the current task if it is free.
  *
- * @param task A pointer to the task to be added.
- * @return True if the task was successfully added, false otherwise.
+ * @param mutex A pointer to the mutex.
+ * @return 0 if the mutex was taken, -1 otherwise.
  */
-bool myos::TaskManager::AddTask(Task *task)
+int myos::TaskManager::TryLockMutex(Mutex *mutex)
 {
-    if (numTasks >= 256)
-        return false;
-    tasks[numTasks++] = task;
-    tasks[numTasks - 1]->id = numTasks - 1;
-    taskQueue.enqueue(numTasks - 1, task->priority);
-    return true;
+    SpinlockGuard guard(&lock);
+    Task *task = CurrentTask();
+    if (task == 0 || mutex->owner != 0)
+        return -1;
+    Acquire(task, mutex);
+    return 0;
 }
 
-void printf(char *);
-void printfHex32(uint32_t);
-
 /**
- * @brief This function is responsible for scheduling tasks in a multitasking system.
+ * Releases a mutex owned by the current task, see HandOff. The caller gives up the CPU
+ * if the new owner is queued on the same processor and now has a higher priority than the caller.
+ * Returns 0 in eax, or -1 if the caller does not own the mutex.
  *
- * @param cpustate A pointer to the CPU state.
- * @return CPUState* A pointer to the CPU state of the next scheduled task.
+ * @param cpustate A pointer to the CPU state of the caller.
+ * @param mutex A pointer to the mutex.
+ * @return A pointer to the CPU state of the next task.
  */
-CPUState *TaskManager::Schedule(CPUState *cpustate)
+CPUState *myos::TaskManager::UnlockMutex(CPUState *cpustate, Mutex *mutex)
 {
-    clockCounter++;
-
-    if (waitingEnter)
+    SpinlockGuard guard(&lock);
+    Processor *processor = CurrentProcessor();
+    Task *task = CurrentTask();
+    if (task == 0 || mutex->owner != task)
     {
+        cpustate->eax = (uint32_t)-1;
         return cpustate;
     }
+    cpustate->eax = 0;
 
-    if (numTasks <= 0)
+    // a new owner queued on another processor preempts the task running there on its next tick
+    Task *next = HandOff(mutex);
+    if (next == 0 || &processors[next->processor] != processor || next->EffectivePriority() <= task->EffectivePriority())
         return cpustate;
+    EnterSyscall(processor, cpustate);
+    return Switch(processor, task, cpustate);
+}
+
+/**
+ * Handles the first FPU or SSE instruction of the running task since it was switched in (#NM).
+ * The state of the previous owner of the registers was saved when it was switched out,
+ * so the registers can be loaded with the state of the running task, or reset on its first use.
+ */
+void myos::TaskManager::LoadFloatingPointState()
+{
+    SpinlockGuard guard(&lock);
+    Processor *processor = CurrentProcessor();
+    Task *task = CurrentTask();
+    FloatingPointUnit::ClearTaskSwitched();
 
-    if (currentTask >= 0)
+    if (task == 0)
     {
-        // printf("Old Task PID: ");
-        // printfHex32(tasks[currentTask]->GetID());
-        // printf(", ");
-        if (cpustate->eax == 7) // waitpid
-        {
-            // printf("Called waitpid, ");
-            tasks[currentTask]->state = TaskState::BLOCKED;
-            tasks[currentTask]->waitingPid = cpustate->ebx;
-            // printf("Waiting for PID: ");
-            // printfHex32(cpustate->ebx);
-            // printf(", ");
-        }
-        else if (cpustate->eax == 1) // exit
-        {
-            // printf("Called exit, ");
-            tasks[currentTask]->state = TaskState::EXITED;
-            tasks[currentTask]->priority = -1;
-        }
-        else
-        {
-            tasks[currentTask]->state = TaskState::READY;
-        }
-        tasks[currentTask]->cpustate = cpustate; // Save the CPU state of the task
+        // the idle context has no state of its own
+        processor->fpuOwner = 0;
+        FloatingPointUnit::Initialize();
+        return;
     }
+    if (processor->fpuOwner == task && task->fpuProcessor == processor - processors)
+        return;
 
-    FindNextTask();
-    // for (int i = 0; i < 5000000; i++)
-    // {
-    //     printf("");
-    // }
-    // printf("New Task PID: ");
-    // printfHex32(tasks[currentTask]->GetID());
-    // printf("\n");
-
-    return tasks[currentTask]->cpustate;
+    if (task->fpuUsed)
+    {
+        FloatingPointUnit::Restore(task->fpuState);
+    }
+    else
+    {
+        FloatingPointUnit::Initialize();
+        task->fpuUsed = true;
+    }
+    processor->fpuOwner = task;
+    task->fpuProcessor = processor - processors;
 }
 
 /**
- * Retrieves the current task.
+ * Retrieves the task running on the calling processor.
  *
  * @return A pointer to the current task if it exists, otherwise returns nullptr.
  */
 Task *TaskManager::GetCurrentTask()
 {
-    return currentTask >= 0 ? tasks[currentTask] : 0;
+    // with interrupts off, so the caller cannot move to another processor halfway through
+    SpinlockGuard guard(&lock);
+    return CurrentTask();
+}
+
+/**
+ * @return The task running on the calling processor, 0 while idle. The lock must be held.
+ */
+Task *myos::TaskManager::CurrentTask()
+{
+    Processor *processor = CurrentProcessor();
+    return processor->currentTask >= 0 ? tasks[processor->currentTask] : 0;
+}
+
+/**
+ * Sets the task that runs on the boot processor whenever no task is ready.
+ * The idle task never enters the task table or the run queues and should only halt the CPU.
+ *
+ * @param task A pointer to the idle task.
+ */
+void myos::TaskManager::SetIdleTask(Task *task)
+{
+    if (task == 0)
+        return;
+    processors[0].idleTask = task;
+    processors[0].idleState = task->cpustate;
+    task->state = TaskState::READY;
+}
+
+/**
+ * @return True if the idle context of the calling processor is running because no task is ready.
+ */
+bool myos::TaskManager::IsIdle()
+{
+    return CurrentProcessor()->idling;
+}
+
+/**
+ * @return True if at least one task is waiting in a run queue of any processor.
+ */
+bool myos::TaskManager::HasReadyTask()
+{
+    if (deadlineQueue != 0)
+        return true;
+    for (int i = 0; i < numProcessors; i++)
+        if (processors[i].numReady > 0)
+            return true;
+    return false;
+}
+
+/**
+ * @return True if a sleeping task still needs clock ticks to be woken.
+ */
+bool myos::TaskManager::HasTimers()
+{
+    return !timers.IsEmpty();
 }
 
 void myos::TaskManager::SetPriority(int priority)
 {
-    tasks[currentTask]->SetPriority(priority);
-    taskQueue.setPriority(currentTask, priority);
+    // The current task is not in a run queue, it is enqueued with the new level on its next preemption
+    SpinlockGuard guard(&lock);
+    CurrentTask()->SetPriority(priority);
+}
+
+void myos::TaskManager::SetTickets(int tickets)
+{
+    SpinlockGuard guard(&lock);
+    CurrentTask()->SetTickets(tickets);
+}
+
+/**
+ * Moves the current task into the deadline class, or back to the scheduler policy.
+ * Deadline tasks run ahead of all other tasks, earliest deadline first, and get up to
+ * their budget of CPU time in every period. A task is only admitted while the budgets of all
+ * deadline tasks add up to at most the whole CPU, so every admitted task meets its deadlines.
+ *
+ * @param periodMs The period, which is also the relative deadline, in milliseconds.
+ * @param budgetMs The CPU time per period in milliseconds, 0 to leave the deadline class.
+ * @return 0 on success, -1 if the budget exceeds the period, the period is too long or the task is not admitted.
+ */
+int myos::TaskManager::SetDeadline(uint32_t periodMs, uint32_t budgetMs)
+{
+    SpinlockGuard guard(&lock);
+    Task *task = CurrentTask();
+    if (budgetMs == 0)
+    {
+        if (task->period != 0)
+        {
+            timers.Cancel(&task->releaseTimer);
+            deadlineUtilization -= task->utilization;
+            task->period = 0;
+        }
+        return 0;
+    }
+
+    uint32_t period = MillisecondsToTicks(periodMs);
+    uint32_t budget = MillisecondsToTicks(budgetMs);
+    if (period > MAX_PERIOD || budget > period)
+        return -1;
+
+    // round up, so rounding never admits a task set that does not fit
+    uint32_t utilization = ((budget << 16) + period - 1) / period;
+    uint32_t others = deadlineUtilization - (task->period != 0 ? task->utilization : 0);
+    if (others + utilization > FULL_UTILIZATION)
+        return -1;
+
+    deadlineUtilization = others + utilization;
+    task->period = period;
+    task->budget = budget;
+    task->utilization = utilization;
+    task->runtime = budget;
+    task->deadline = clockCounter + period;
+    timers.Add(&task->releaseTimer, timers.Now() + period);
+    return 0;
 }
 
 int myos::TaskManager::GetNumTasks()
 {
-    return numTasks;
+    return numTasks - numFreePids;
 }
 
 Task *myos::TaskManager::GetTask(int id)
@@ -224,6 +1609,87 @@ common::size_t myos::TaskManager::GetClockCounter()
     return clockCounter;
 }
 
+/**
+ * @return The clock ticks the processors spent idle, summed over all processors.
+ */
+common::size_t myos::TaskManager::GetIdleTicks()
+{
+    size_t ticks = 0;
+    for (int i = 0; i < numProcessors; i++)
+        ticks += processors[i].idleTicks;
+    return ticks;
+}
+
+/**
+ * Copies the CPU accounting of a task, including the time spent in its current state so far.
+ *
+ * @param pid The ID of the task.
+ * @param statistics A pointer to the structure to fill.
+ * @return 1 if the statistics were filled, 0 if the PID is unused, -1 if the PID was never handed out.
+ */
+int myos::TaskManager::GetStatistics(int pid, TaskStatistics *statistics)
+{
+    SpinlockGuard guard(&lock);
+    if (pid < 0 || pid >= numTasks)
+        return -1;
+    Task *task = tasks[pid];
+    if (task == 0)
+        return 0;
+
+    *statistics = task->statistics;
+    statistics->pid = pid;
+    statistics->state = task->state;
+    statistics->priority = task->priority;
+    statistics->tickets = task->tickets;
+
+    uint32_t ticks = clockCounter - task->stateSince;
+    if (task->state == TaskState::RUNNING)
+        statistics->runningTicks += ticks;
+    else if (task->state == TaskState::READY)
+        statistics->readyTicks += ticks;
+    else if (task->state == TaskState::BLOCKED || task->state == TaskState::SLEEPING)
+        statistics->blockedTicks += ticks;
+    return 1;
+}
+
+/**
+ * Tells the task manager how often Schedule is called by the clock.
+ *
+ * @param hz The clock ticks per second.
+ */
+void myos::TaskManager::SetTickRate(uint32_t hz)
+{
+    tickRate = hz;
+}
+
+uint32_t myos::TaskManager::GetTickRate()
+{
+    return tickRate;
+}
+
+/**
+ * Sets the time slice of tasks with the given priority.
+ * Priorities above the highest level share the quantum of the highest level.
+ *
+ * @param priority The priority level.
+ * @param ticks The time slice in clock ticks, at least 1.
+ */
+void myos::TaskManager::SetQuantum(int priority, uint32_t ticks)
+{
+    if (priority < 0 || priority >= NUM_PRIORITIES)
+        return;
+    quantum[priority] = ticks > 0 ? ticks : 1;
+}
+
+uint32_t myos::TaskManager::GetQuantum(int priority)
+{
+    if (priority < 0)
+        priority = 0;
+    if (priority >= NUM_PRIORITIES)
+        priority = NUM_PRIORITIES - 1;
+    return quantum[priority];
+}
+
 void myos::TaskManager::WaitEnter()
 {
     waitingEnter = true;
@@ -236,24 +1702,53 @@ void myos::TaskManager::SignalEnter()
 
 void myos::TaskManager::HavePriority()
 {
-    checkPriority = true;
+    SpinlockGuard guard(&lock);
+    for (int i = 0; i < numProcessors; i++)
+        processors[i].policy->UsePriorities(true);
 }
 
 void myos::TaskManager::DontHavePriority()
 {
-    checkPriority = false;
+    SpinlockGuard guard(&lock);
+    for (int i = 0; i < numProcessors; i++)
+        processors[i].policy->UsePriorities(false);
 }
 
 /**
  * Forks a new task in the task manager.
  *
  * @param esp The value of the stack pointer of the parent task.
- * @return The ID of the newly created task.
+ * @return The ID of the newly created task, or -1 if it could not be created.
  */
 int myos::TaskManager::fork(uint32_t esp)
 {
+    SpinlockGuard guard(&lock);
     Task *task = new Task(esp);
-    task->priority = tasks[currentTask]->priority;
-    AddTask(task);
-    return tasks[numTasks - 1]->id;
+    if (task == 0)
+        return -1;
+    task->priority = CurrentTask()->priority;
+    if (!Insert(task))
+    {
+        delete task;
+        return -1;
+    }
+    return task->id;
+}
+
+/**
+ * Allocates memory for the calling task that lives until the task exits, without a matching free.
+ * Meant for the many small objects of short-lived tasks, only to be called from task context.
+ *
+ * @param size The size of the memory.
+ * @return A pointer to the memory, or 0 if there is no current task or the heap is exhausted.
+ */
+void *task_alloc(size_t size)
+{
+    TaskManager *taskManager = TaskManager::activeTaskManager;
+    if (taskManager == 0)
+        return 0;
+    Task *task = taskManager->GetCurrentTask();
+    if (task == 0)
+        return 0;
+    return task->Allocate(size);
 }
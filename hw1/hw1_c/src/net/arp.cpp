@@ -1,5 +1,6 @@
 
 #include <net/arp.h>
+#include <synchronization.h>
 using namespace myos;
 using namespace myos::common;
 using namespace myos::net;
@@ -50,6 +51,7 @@ bool AddressResolutionProtocol::OnEtherFrameReceived(uint8_t* etherframePayload,
                         IPcache[numCacheEntries] = arp->srcIP;
                         MACcache[numCacheEntries] = arp->srcMAC;
                         numCacheEntries++;
+                        Futex::Wake(&numCacheEntries, Futex::ALL);
                     }
                     break;
             }
@@ -101,20 +103,30 @@ void AddressResolutionProtocol::RequestMACAddress(uint32_t IP_BE)
 
 uint64_t AddressResolutionProtocol::GetMACFromCache(uint32_t IP_BE)
 {
-    for(int i = 0; i < numCacheEntries; i++)
+    for(uint32_t i = 0; i < numCacheEntries; i++)
         if(IPcache[i] == IP_BE)
             return MACcache[i];
     return 0xFFFFFFFFFFFF; // broadcast address
 }
 
+// Sends a request and sleeps until the response is cached, a few times before giving up on the broadcast address.
+// In an interrupt handler nothing can arrive meanwhile, so the requests go out without waiting.
 uint64_t AddressResolutionProtocol::Resolve(uint32_t IP_BE)
 {
     uint64_t result = GetMACFromCache(IP_BE);
-    if(result == 0xFFFFFFFFFFFF)
+    for(int attempt = 0; result == 0xFFFFFFFFFFFF && attempt < 3; attempt++)
+    {
         RequestMACAddress(IP_BE);
-
-    while(result == 0xFFFFFFFFFFFF) // possible infinite loop
-        result = GetMACFromCache(IP_BE);
+        int woken = 0;
+        while(woken != Futex::TIMED_OUT)
+        {
+            uint32_t seen = numCacheEntries;
+            result = GetMACFromCache(IP_BE);
+            if(result != 0xFFFFFFFFFFFF)
+                break;
+            woken = Futex::Wait(&numCacheEntries, seen, 1000);
+        }
+    }
     
     return result;
 }
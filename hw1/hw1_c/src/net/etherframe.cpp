@@ -75,9 +75,41 @@ bool EtherFrameProvider::OnRawDataReceived(common::uint8_t* buffer, common::uint
     return sendBack;
 }
 
+SlabCache EtherFrameProvider::packetBuffers("packet buffer", PACKET_BUFFER_SIZE);
+
+/**
+ * Allocates a buffer to build an outgoing packet in. Packets up to PACKET_BUFFER_SIZE come from
+ * the packet buffer cache, larger ones from the heap.
+ *
+ * @param size The size of the packet.
+ * @return The buffer, or 0 if there is no memory.
+ */
+uint8_t* EtherFrameProvider::AllocateBuffer(uint32_t size)
+{
+    if(size <= PACKET_BUFFER_SIZE)
+        return (uint8_t*)packetBuffers.Allocate();
+    if(MemoryManager::activeMemoryManager == 0)
+        return 0;
+    return (uint8_t*)MemoryManager::activeMemoryManager->malloc(size);
+}
+
+/**
+ * @param buffer A buffer from AllocateBuffer.
+ * @param size The size it was allocated with.
+ */
+void EtherFrameProvider::FreeBuffer(uint8_t* buffer, uint32_t size)
+{
+    if(size <= PACKET_BUFFER_SIZE)
+        packetBuffers.Free(buffer);
+    else if(MemoryManager::activeMemoryManager != 0)
+        MemoryManager::activeMemoryManager->free(buffer);
+}
+
 void EtherFrameProvider::Send(common::uint64_t dstMAC_BE, common::uint16_t etherType_BE, common::uint8_t* buffer, common::uint32_t size)
 {
-    uint8_t* buffer2 = (uint8_t*)MemoryManager::activeMemoryManager->malloc(sizeof(EtherFrameHeader) + size);
+    uint8_t* buffer2 = AllocateBuffer(sizeof(EtherFrameHeader) + size);
+    if(buffer2 == 0)
+        return;
     EtherFrameHeader* frame = (EtherFrameHeader*)buffer2;
     
     frame->dstMAC_BE = dstMAC_BE;
@@ -91,7 +123,7 @@ void EtherFrameProvider::Send(common::uint64_t dstMAC_BE, common::uint16_t ether
     
     backend->Send(buffer2, size + sizeof(EtherFrameHeader));
     
-    MemoryManager::activeMemoryManager->free(buffer2);
+    FreeBuffer(buffer2, sizeof(EtherFrameHeader) + size);
 }
 
 uint32_t EtherFrameProvider::GetIPAddress()
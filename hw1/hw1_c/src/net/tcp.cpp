@@ -1,6 +1,7 @@
  
 
 #include <net/tcp.h>
+#include <synchronization.h>
 
 using namespace myos;
 using namespace myos::common;
@@ -36,6 +37,18 @@ TransmissionControlProtocolSocket::~TransmissionControlProtocolSocket()
 {
 }
 
+SlabCache TransmissionControlProtocolSocket::cache("tcp socket", sizeof(TransmissionControlProtocolSocket));
+
+void* TransmissionControlProtocolSocket::operator new(size_t size) throw()
+{
+    return cache.Allocate();
+}
+
+void TransmissionControlProtocolSocket::operator delete(void* ptr)
+{
+    cache.Free(ptr);
+}
+
 bool TransmissionControlProtocolSocket::HandleTransmissionControlProtocolMessage(uint8_t* data, uint16_t size)
 {
     if(handler != 0)
@@ -43,12 +56,20 @@ bool TransmissionControlProtocolSocket::HandleTransmissionControlProtocolMessage
     return false;
 }
 
-void TransmissionControlProtocolSocket::Send(uint8_t* data, uint16_t size)
+/**
+ * Sends data, sleeping until the handshake completes if the connection is still being opened.
+ *
+ * @return False if the connection is not ESTABLISHED, e.g. reset or closed, and nothing was sent.
+ */
+bool TransmissionControlProtocolSocket::Send(uint8_t* data, uint16_t size)
 {
-    while(state != ESTABLISHED)
-    {
-    }
+    TransmissionControlProtocolSocketState seen;
+    while((seen = state) == LISTEN || seen == SYN_SENT || seen == SYN_RECEIVED)
+        Futex::Wait((volatile uint32_t*)&state, seen);
+    if(seen != ESTABLISHED)
+        return false;
     backend->Send(this, data, size, PSH|ACK);
+    return true;
 }
 
 void TransmissionControlProtocolSocket::Disconnect()
@@ -56,6 +77,20 @@ void TransmissionControlProtocolSocket::Disconnect()
     backend->Disconnect(this);
 }
 
+TransmissionControlProtocolSocketState TransmissionControlProtocolSocket::GetState()
+{
+    return state;
+}
+
+/**
+ * Changes the state and wakes the tasks waiting in Send, which sleep on the state.
+ */
+void TransmissionControlProtocolSocket::SetState(TransmissionControlProtocolSocketState state)
+{
+    this->state = state;
+    Futex::Wake((volatile uint32_t*)&this->state, Futex::ALL);
+}
+
 
 
 
@@ -120,7 +155,7 @@ bool TransmissionControlProtocolProvider::OnInternetProtocolReceived(uint32_t sr
     bool reset = false;
     
     if(socket != 0 && msg->flags & RST)
-        socket->state = CLOSED;
+        socket->SetState(CLOSED);
 
     
     if(socket != 0 && socket->state != CLOSED)
@@ -130,7 +165,7 @@ bool TransmissionControlProtocolProvider::OnInternetProtocolReceived(uint32_t sr
             case SYN:
                 if(socket -> state == LISTEN)
                 {
-                    socket->state = SYN_RECEIVED;
+                    socket->SetState(SYN_RECEIVED);
                     socket->remotePort = msg->srcPort;
                     socket->remoteIP = srcIP_BE;
                     socket->acknowledgementNumber = bigEndian32( msg->sequenceNumber ) + 1;
@@ -146,7 +181,7 @@ bool TransmissionControlProtocolProvider::OnInternetProtocolReceived(uint32_t sr
             case SYN | ACK:
                 if(socket->state == SYN_SENT)
                 {
-                    socket->state = ESTABLISHED;
+                    socket->SetState(ESTABLISHED);
                     socket->acknowledgementNumber = bigEndian32( msg->sequenceNumber ) + 1;
                     socket->sequenceNumber++;
                     Send(socket, 0,0, ACK);
@@ -166,19 +201,19 @@ bool TransmissionControlProtocolProvider::OnInternetProtocolReceived(uint32_t sr
             case FIN|ACK:
                 if(socket->state == ESTABLISHED)
                 {
-                    socket->state = CLOSE_WAIT;
+                    socket->SetState(CLOSE_WAIT);
                     socket->acknowledgementNumber++;
                     Send(socket, 0,0, ACK);
                     Send(socket, 0,0, FIN|ACK);
                 }
                 else if(socket->state == CLOSE_WAIT)
                 {
-                    socket->state = CLOSED;
+                    socket->SetState(CLOSED);
                 }
                 else if(socket->state == FIN_WAIT1
                     || socket->state == FIN_WAIT2)
                 {
-                    socket->state = CLOSED;
+                    socket->SetState(CLOSED);
                     socket->acknowledgementNumber++;
                     Send(socket, 0,0, ACK);
                 }
@@ -190,17 +225,17 @@ bool TransmissionControlProtocolProvider::OnInternetProtocolReceived(uint32_t sr
             case ACK:
                 if(socket->state == SYN_RECEIVED)
                 {
-                    socket->state = ESTABLISHED;
+                    socket->SetState(ESTABLISHED);
                     return false;
                 }
                 else if(socket->state == FIN_WAIT1)
                 {
-                    socket->state = FIN_WAIT2;
+                    socket->SetState(FIN_WAIT2);
                     return false;
                 }
                 else if(socket->state == CLOSE_WAIT)
                 {
-                    socket->state = CLOSED;
+                    socket->SetState(CLOSED);
                     break;
                 }
                 
@@ -260,7 +295,7 @@ bool TransmissionControlProtocolProvider::OnInternetProtocolReceived(uint32_t sr
             if(sockets[i] == socket)
             {
                 sockets[i] = sockets[--numSockets];
-                MemoryManager::activeMemoryManager->free(socket);
+                delete socket;
                 break;
             }
     
@@ -291,7 +326,9 @@ void TransmissionControlProtocolProvider::Send(TransmissionControlProtocolSocket
     uint16_t totalLength = size + sizeof(TransmissionControlProtocolHeader);
     uint16_t lengthInclPHdr = totalLength + sizeof(TransmissionControlProtocolPseudoHeader);
     
-    uint8_t* buffer = (uint8_t*)MemoryManager::activeMemoryManager->malloc(lengthInclPHdr);
+    uint8_t* buffer = EtherFrameProvider::AllocateBuffer(lengthInclPHdr);
+    if(buffer == 0)
+        return;
     
     TransmissionControlProtocolPseudoHeader* phdr = (TransmissionControlProtocolPseudoHeader*)buffer;
     TransmissionControlProtocolHeader* msg = (TransmissionControlProtocolHeader*)(buffer + sizeof(TransmissionControlProtocolPseudoHeader));
@@ -327,19 +364,17 @@ void TransmissionControlProtocolProvider::Send(TransmissionControlProtocolSocket
     
     
     InternetProtocolHandler::Send(socket->remoteIP, (uint8_t*)msg, totalLength);
-    MemoryManager::activeMemoryManager->free(buffer);
+    EtherFrameProvider::FreeBuffer(buffer, lengthInclPHdr);
 }
 
 
 
 TransmissionControlProtocolSocket* TransmissionControlProtocolProvider::Connect(uint32_t ip, uint16_t port)
 {
-    TransmissionControlProtocolSocket* socket = (TransmissionControlProtocolSocket*)MemoryManager::activeMemoryManager->malloc(sizeof(TransmissionControlProtocolSocket));
+    TransmissionControlProtocolSocket* socket = new TransmissionControlProtocolSocket(this);
     
     if(socket != 0)
     {
-        new (socket) TransmissionControlProtocolSocket(this);
-        
         socket -> remotePort = port;
         socket -> remoteIP = ip;
         socket -> localPort = freePort++;
@@ -363,7 +398,7 @@ TransmissionControlProtocolSocket* TransmissionControlProtocolProvider::Connect(
 
 void TransmissionControlProtocolProvider::Disconnect(TransmissionControlProtocolSocket* socket)
 {
-    socket->state = FIN_WAIT1;
+    socket->SetState(FIN_WAIT1);
     Send(socket, 0,0, FIN + ACK);
     socket->sequenceNumber++;
 }
@@ -371,12 +406,10 @@ void TransmissionControlProtocolProvider::Disconnect(TransmissionControlProtocol
 
 TransmissionControlProtocolSocket* TransmissionControlProtocolProvider::Listen(uint16_t port)
 {
-    TransmissionControlProtocolSocket* socket = (TransmissionControlProtocolSocket*)MemoryManager::activeMemoryManager->malloc(sizeof(TransmissionControlProtocolSocket));
+    TransmissionControlProtocolSocket* socket = new TransmissionControlProtocolSocket(this);
     
     if(socket != 0)
     {
-        new (socket) TransmissionControlProtocolSocket(this);
-        
         socket -> state = LISTEN;
         socket -> localIP = backend->GetIPAddress();
         socket -> localPort = ((port & 0xFF00)>>8) | ((port & 0x00FF) << 8);
@@ -34,6 +34,18 @@ UserDatagramProtocolSocket::~UserDatagramProtocolSocket()
 {
 }
 
+SlabCache UserDatagramProtocolSocket::cache("udp socket", sizeof(UserDatagramProtocolSocket));
+
+void* UserDatagramProtocolSocket::operator new(size_t size) throw()
+{
+    return cache.Allocate();
+}
+
+void UserDatagramProtocolSocket::operator delete(void* ptr)
+{
+    cache.Free(ptr);
+}
+
 void UserDatagramProtocolSocket::HandleUserDatagramProtocolMessage(uint8_t* data, uint16_t size)
 {
     if(handler != 0)
@@ -108,12 +120,10 @@ bool UserDatagramProtocolProvider::OnInternetProtocolReceived(uint32_t srcIP_BE,
 
 UserDatagramProtocolSocket* UserDatagramProtocolProvider::Connect(uint32_t ip, uint16_t port)
 {
-    UserDatagramProtocolSocket* socket = (UserDatagramProtocolSocket*)MemoryManager::activeMemoryManager->malloc(sizeof(UserDatagramProtocolSocket));
+    UserDatagramProtocolSocket* socket = new UserDatagramProtocolSocket(this);
     
     if(socket != 0)
     {
-        new (socket) UserDatagramProtocolSocket(this);
-        
         socket -> remotePort = port;
         socket -> remoteIP = ip;
         socket -> localPort = freePort++;
@@ -132,12 +142,10 @@ UserDatagramProtocolSocket* UserDatagramProtocolProvider::Connect(uint32_t ip, u
 
 UserDatagramProtocolSocket* UserDatagramProtocolProvider::Listen(uint16_t port)
 {
-    UserDatagramProtocolSocket* socket = (UserDatagramProtocolSocket*)MemoryManager::activeMemoryManager->malloc(sizeof(UserDatagramProtocolSocket));
+    UserDatagramProtocolSocket* socket = new UserDatagramProtocolSocket(this);
     
     if(socket != 0)
     {
-        new (socket) UserDatagramProtocolSocket(this);
-        
         socket -> listening = true;
         socket -> localPort = port;
         socket -> localIP = backend->GetIPAddress();
@@ -157,7 +165,7 @@ void UserDatagramProtocolProvider::Disconnect(UserDatagramProtocolSocket* socket
         if(sockets[i] == socket)
         {
             sockets[i] = sockets[--numSockets];
-            MemoryManager::activeMemoryManager->free(socket);
+            delete socket;
             break;
         }
 }
@@ -165,7 +173,9 @@ void UserDatagramProtocolProvider::Disconnect(UserDatagramProtocolSocket* socket
 void UserDatagramProtocolProvider::Send(UserDatagramProtocolSocket* socket, uint8_t* data, uint16_t size)
 {
     uint16_t totalLength = size + sizeof(UserDatagramProtocolHeader);
-    uint8_t* buffer = (uint8_t*)MemoryManager::activeMemoryManager->malloc(totalLength);
+    uint8_t* buffer = EtherFrameProvider::AllocateBuffer(totalLength);
+    if(buffer == 0)
+        return;
     uint8_t* buffer2 = buffer + sizeof(UserDatagramProtocolHeader);
     
     UserDatagramProtocolHeader* msg = (UserDatagramProtocolHeader*)buffer;
@@ -180,7 +190,7 @@ void UserDatagramProtocolProvider::Send(UserDatagramProtocolSocket* socket, uint
     msg -> checksum = 0;
     InternetProtocolHandler::Send(socket->remoteIP, buffer, totalLength);
 
-    MemoryManager::activeMemoryManager->free(buffer);
+    EtherFrameProvider::FreeBuffer(buffer, totalLength);
 }
 
 void UserDatagramProtocolProvider::Bind(UserDatagramProtocolSocket* socket, UserDatagramProtocolHandler* handler)
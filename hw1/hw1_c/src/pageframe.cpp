@@ -0,0 +1,280 @@
+#include <pageframe.h>
+
+using namespace myos;
+using namespace myos::common;
+
+void printf(char *);
+
+// An entry of the multiboot memory map, size does not count itself
+struct MultibootMemoryMap
+{
+    uint32_t size;
+    uint64_t base;
+    uint64_t length;
+    uint32_t type; // 1 for RAM that is free to use
+} __attribute__((packed));
+
+static const int MAX_REGIONS = 32;
+static const uint32_t MULTIBOOT_INFO_SIZE = 88;
+static const uint32_t HIGHEST_ADDRESS = 0xFFFFF000; // memory above 4 GiB is out of reach
+
+PageFrameAllocator *myos::PageFrameAllocator::activePageFrameAllocator = 0;
+
+/**
+ * Reads the RAM available from the multiboot information, from the memory map if the
+ * boot loader passed one and from mem_upper otherwise.
+ *
+ * @param multiboot_structure The multiboot information.
+ * @param regions Filled with [start, end) pairs, clipped to HIGHEST_ADDRESS.
+ * @return The number of regions.
+ */
+static int ReadMemoryMap(const void *multiboot_structure, uint32_t regions[][2])
+{
+    uint32_t flags = *(uint32_t *)multiboot_structure;
+    int numRegions = 0;
+
+    if (flags & (1 << 6))
+    {
+        uint32_t length = *(uint32_t *)((size_t)multiboot_structure + 44);
+        uint32_t address = *(uint32_t *)((size_t)multiboot_structure + 48);
+        for (uint32_t offset = 0; offset < length && numRegions < MAX_REGIONS;)
+        {
+            MultibootMemoryMap *entry = (MultibootMemoryMap *)(address + offset);
+            offset += entry->size + sizeof(entry->size);
+            if (entry->type != 1 || entry->base >= HIGHEST_ADDRESS)
+                continue;
+            uint64_t end = entry->base + entry->length;
+            regions[numRegions][0] = (uint32_t)entry->base;
+            regions[numRegions][1] = end > HIGHEST_ADDRESS ? HIGHEST_ADDRESS : (uint32_t)end;
+            numRegions++;
+        }
+    }
+    else if (flags & (1 << 0))
+    {
+        uint32_t memupper = *(uint32_t *)((size_t)multiboot_structure + 8); // KiB above 1 MiB
+        regions[0][0] = 0x100000;
+        regions[0][1] = 0x100000 + memupper * 1024;
+        numRegions = 1;
+    }
+    return numRegions;
+}
+
+/**
+ * Hands all RAM in the memory map to the allocator, except the kernel, the multiboot information
+ * and the frame table, which is placed in the first free space large enough.
+ *
+ * @param multiboot_structure The multiboot information.
+ * @param kernelEnd The end of the kernel image, everything below it is kept out.
+ */
+myos::PageFrameAllocator::PageFrameAllocator(const void *multiboot_structure, size_t kernelEnd)
+{
+    activePageFrameAllocator = this;
+    for (int order = 0; order <= MAX_ORDER; order++)
+        freeLists[order] = 0;
+    frames = 0;
+    numFrames = 0;
+    freeFrames = 0;
+    totalFrames = 0;
+    numReserved = 0;
+
+    uint32_t regions[MAX_REGIONS][2];
+    int numRegions = ReadMemoryMap(multiboot_structure, regions);
+    for (int i = 0; i < numRegions; i++)
+        if ((regions[i][1] >> PAGE_SHIFT) > numFrames)
+            numFrames = regions[i][1] >> PAGE_SHIFT;
+
+    uint32_t flags = *(uint32_t *)multiboot_structure;
+    Reserve(0, kernelEnd);
+    Reserve((uint32_t)multiboot_structure, (uint32_t)multiboot_structure + MULTIBOOT_INFO_SIZE);
+    if (flags & (1 << 2))
+    {
+        char *cmdline = *(char **)((size_t)multiboot_structure + 16);
+        uint32_t length = 0;
+        while (cmdline[length] != '\0')
+            length++;
+        Reserve((uint32_t)cmdline, (uint32_t)cmdline + length + 1);
+    }
+    if (flags & (1 << 6))
+    {
+        uint32_t address = *(uint32_t *)((size_t)multiboot_structure + 48);
+        Reserve(address, address + *(uint32_t *)((size_t)multiboot_structure + 44));
+    }
+
+    // one byte per frame, in the first free space of a region that does not overlap a reservation
+    for (int i = 0; i < numRegions && frames == 0; i++)
+    {
+        uint32_t start = (regions[i][0] + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        for (int j = 0; j < numReserved && start + numFrames <= regions[i][1]; j++)
+            if (reserved[j][0] < start + numFrames && reserved[j][1] > start)
+            {
+                start = (reserved[j][1] + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+                j = -1; // check all reservations again at the new place
+            }
+        if (start + numFrames <= regions[i][1])
+            frames = (uint8_t *)start;
+    }
+    if (frames == 0)
+    {
+        numFrames = 0;
+        return;
+    }
+    for (uint32_t frame = 0; frame < numFrames; frame++)
+        frames[frame] = 0;
+    Reserve((uint32_t)frames, (uint32_t)frames + numFrames);
+
+    for (int i = 0; i < numRegions; i++)
+        AddRange(regions[i][0], regions[i][1]);
+}
+
+myos::PageFrameAllocator::~PageFrameAllocator()
+{
+    if (activePageFrameAllocator == this)
+        activePageFrameAllocator = 0;
+}
+
+/**
+ * Keeps a range of memory from being handed out. Running out of room for reservations halts,
+ * since the range would otherwise be handed out while in use.
+ */
+void myos::PageFrameAllocator::Reserve(uint32_t start, uint32_t end)
+{
+    if (numReserved == MAX_RESERVED)
+    {
+        printf("pageframe: too many reserved ranges, raise MAX_RESERVED\n");
+        while (true)
+            asm volatile("cli; hlt");
+    }
+    reserved[numReserved][0] = start;
+    reserved[numReserved][1] = end;
+    numReserved++;
+}
+
+/**
+ * Frees the whole pages of a range of RAM that are not reserved, as the largest aligned blocks that fit.
+ */
+void myos::PageFrameAllocator::AddRange(uint32_t start, uint32_t end)
+{
+    for (int i = 0; i < numReserved; i++)
+        if (reserved[i][0] < end && reserved[i][1] > start)
+        {
+            if (reserved[i][0] > start)
+                AddRange(start, reserved[i][0]);
+            if (reserved[i][1] < end)
+                AddRange(reserved[i][1], end);
+            return;
+        }
+
+    uint32_t frame = (start + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uint32_t last = end >> PAGE_SHIFT;
+    while (frame < last)
+    {
+        int order = MAX_ORDER;
+        while (order > 0 && ((frame & ((1u << order) - 1)) != 0 || frame + (1u << order) > last))
+            order--;
+        Insert(frame, order);
+        freeFrames += 1u << order;
+        totalFrames += 1u << order;
+        frame += 1u << order;
+    }
+}
+
+void myos::PageFrameAllocator::Insert(uint32_t frame, int order)
+{
+    FreeBlock *block = (FreeBlock *)(frame << PAGE_SHIFT);
+    block->prev = 0;
+    block->next = freeLists[order];
+    if (block->next != 0)
+        block->next->prev = block;
+    freeLists[order] = block;
+    frames[frame] = FREE | order;
+}
+
+void myos::PageFrameAllocator::Remove(uint32_t frame, int order)
+{
+    FreeBlock *block = (FreeBlock *)(frame << PAGE_SHIFT);
+    if (block->next != 0)
+        block->next->prev = block->prev;
+    if (block->prev != 0)
+        block->prev->next = block->next;
+    else
+        freeLists[order] = block->next;
+    frames[frame] = 0;
+}
+
+/**
+ * Allocates a block of contiguous page frames, splitting a larger block if no block of the order is free.
+ *
+ * @param order The block holds 2^order pages and is aligned to its size.
+ * @return The physical address of the block, or 0 if there is none.
+ */
+void *myos::PageFrameAllocator::AllocatePages(int order)
+{
+    if (order < 0 || order > MAX_ORDER)
+        return 0;
+
+    SpinlockGuard guard(&lock);
+    int available = order;
+    while (available <= MAX_ORDER && freeLists[available] == 0)
+        available++;
+    if (available > MAX_ORDER)
+        return 0;
+
+    uint32_t frame = (uint32_t)freeLists[available] >> PAGE_SHIFT;
+    Remove(frame, available);
+    while (available > order)
+    {
+        // the upper half goes back to the free list one order below
+        available--;
+        Insert(frame + (1u << available), available);
+    }
+    freeFrames -= 1u << order;
+    return (void *)(frame << PAGE_SHIFT);
+}
+
+/**
+ * Returns a block and merges it with its buddy as long as the buddy is free.
+ *
+ * @param address A block from AllocatePages.
+ * @param order The order it was allocated with.
+ */
+void myos::PageFrameAllocator::FreePages(void *address, int order)
+{
+    if (address == 0)
+        return;
+
+    SpinlockGuard guard(&lock);
+    uint32_t frame = (uint32_t)address >> PAGE_SHIFT;
+    freeFrames += 1u << order;
+    while (order < MAX_ORDER)
+    {
+        uint32_t buddy = frame ^ (1u << order);
+        if (buddy >= numFrames || frames[buddy] != (FREE | order))
+            break;
+        Remove(buddy, order);
+        frame &= ~(1u << order);
+        order++;
+    }
+    Insert(frame, order);
+}
+
+uint32_t myos::PageFrameAllocator::FreeFrames()
+{
+    return freeFrames;
+}
+
+uint32_t myos::PageFrameAllocator::TotalFrames()
+{
+    return totalFrames;
+}
+
+/**
+ * @param size A size in bytes.
+ * @return The smallest order of a block holding size bytes, greater than MAX_ORDER if there is none.
+ */
+int myos::PageFrameAllocator::Order(size_t size)
+{
+    int order = 0;
+    while (order <= MAX_ORDER && (PAGE_SIZE << order) < size)
+        order++;
+    return order;
+}
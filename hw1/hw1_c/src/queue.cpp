@@ -2,45 +2,95 @@
 
 myos::PriorityQueue::PriorityQueue()
 {
+    count = 0;
+    nextSequence = 0;
+    for (int i = 0; i < CAPACITY; i++)
+    {
+        nodes[i].data = i;
+        nodes[i].priority = 0;
+        nodes[i].sequence = 0;
+        nodes[i].position = -1;
+    }
 }
 
 myos::PriorityQueue::~PriorityQueue()
 {
-    while (!isEmpty())
-    {
-        dequeue();
-    }
 }
 
 // Check if the priority queue is empty
 bool myos::PriorityQueue::isEmpty()
 {
-    return head == nullptr;
+    return count == 0;
 }
 
-// Insert an element with a given priority
-void myos::PriorityQueue::enqueue(int data, int priority)
+int myos::PriorityQueue::size()
 {
-    Node *newNode = new Node;
-    newNode->data = data;
-    newNode->priority = priority;
+    return count;
+}
+
+bool myos::PriorityQueue::contains(int data)
+{
+    return data >= 0 && data < CAPACITY && nodes[data].position >= 0;
+}
 
-    // If the queue is empty or the new node has higher priority
-    if (isEmpty() || priority > head->priority)
+// Higher priority first, equal priorities in insertion order
+bool myos::PriorityQueue::before(Node *a, Node *b)
+{
+    if (a->priority != b->priority)
+        return a->priority > b->priority;
+    return (int)(a->sequence - b->sequence) < 0;
+}
+
+void myos::PriorityQueue::place(Node *node, int position)
+{
+    heap[position] = node;
+    node->position = position;
+}
+
+void myos::PriorityQueue::siftUp(int position)
+{
+    Node *node = heap[position];
+    while (position > 0)
     {
-        newNode->next = head;
-        head = newNode;
+        int parent = (position - 1) / 2;
+        if (!before(node, heap[parent]))
+            break;
+        place(heap[parent], position);
+        position = parent;
     }
-    else
+    place(node, position);
+}
+
+void myos::PriorityQueue::siftDown(int position)
+{
+    Node *node = heap[position];
+    while (true)
     {
-        Node *current = head;
-        while (current->next != nullptr && current->next->priority >= priority)
-        {
-            current = current->next;
-        }
-        newNode->next = current->next;
-        current->next = newNode;
+        int child = 2 * position + 1;
+        if (child >= count)
+            break;
+        if (child + 1 < count && before(heap[child + 1], heap[child]))
+            child++;
+        if (!before(heap[child], node))
+            break;
+        place(heap[child], position);
+        position = child;
     }
+    place(node, position);
+}
+
+// Insert an element with a given priority
+bool myos::PriorityQueue::enqueue(int data, int priority)
+{
+    if (data < 0 || data >= CAPACITY || nodes[data].position >= 0)
+        return false;
+
+    Node *node = &nodes[data];
+    node->priority = priority;
+    node->sequence = nextSequence++;
+    place(node, count++);
+    siftUp(node->position);
+    return true;
 }
 
 // Remove and return the element with the highest priority
@@ -51,10 +101,8 @@ int myos::PriorityQueue::dequeue()
         return -1;
     }
 
-    Node *temp = head;
-    int data = head->data;
-    head = head->next;
-    // delete temp;
+    int data = heap[0]->data;
+    remove(data);
     return data;
 }
 
@@ -66,24 +114,39 @@ int myos::PriorityQueue::peek()
         return -1;
     }
 
-    return head->data;
+    return heap[0]->data;
 }
 
 void myos::PriorityQueue::setPriority(int data, int priority)
 {
-    if (isEmpty())
+    if (!contains(data))
     {
         return;
     }
 
-    Node *current = head;
-    while (current != nullptr && current->data != data)
-    {
-        current = current->next;
-    }
+    Node *node = &nodes[data];
+    int old = node->priority;
+    node->priority = priority;
+    if (priority > old)
+        siftUp(node->position);
+    else if (priority < old)
+        siftDown(node->position);
+}
 
-    if (current != nullptr)
+void myos::PriorityQueue::remove(int data)
+{
+    if (!contains(data))
     {
-        current->priority = priority;
+        return;
     }
+
+    int position = nodes[data].position;
+    nodes[data].position = -1;
+    Node *last = heap[--count];
+    if (position == count)
+        return;
+
+    place(last, position);
+    siftUp(position);
+    siftDown(last->position);
 }
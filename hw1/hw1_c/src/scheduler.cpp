@@ -0,0 +1,610 @@
+#include <scheduler.h>
+#include <multitasking.h>
+
+using namespace myos;
+using namespace myos::common;
+
+RunQueue::RunQueue()
+{
+    for (int i = 0; i < LEVELS; i++)
+    {
+        head[i] = 0;
+        tail[i] = 0;
+    }
+    bitmap = 0;
+}
+
+RunQueue::~RunQueue()
+{
+}
+
+/**
+ * Appends a task to the tail of a level and marks the level as non-empty.
+ *
+ * @param task A pointer to the task.
+ * @param level The level, clamped to [0, LEVELS).
+ */
+void RunQueue::Push(Task *task, int level)
+{
+    if (level < 0)
+        level = 0;
+    if (level >= LEVELS)
+        level = LEVELS - 1;
+
+    task->nextReady = 0;
+    if (tail[level] != 0)
+        tail[level]->nextReady = task;
+    else
+        head[level] = task;
+    tail[level] = task;
+    bitmap |= 1u << level;
+}
+
+/**
+ * Removes the task at the head of the highest non-empty level.
+ *
+ * @return A pointer to the removed task, or 0 if the queue is empty.
+ */
+Task *RunQueue::Pop()
+{
+    int level = Highest();
+    if (level < 0)
+        return 0;
+
+    Task *task = head[level];
+    head[level] = task->nextReady;
+    if (head[level] == 0)
+    {
+        tail[level] = 0;
+        bitmap &= ~(1u << level);
+    }
+    task->nextReady = 0;
+    return task;
+}
+
+/**
+ * Empties the queue.
+ *
+ * @return All tasks, highest level first, linked through nextReady.
+ */
+Task *RunQueue::PopAll()
+{
+    Task *first = 0;
+    Task *last = 0;
+    for (int level = LEVELS - 1; level >= 0; level--)
+    {
+        if (head[level] == 0)
+            continue;
+        if (last != 0)
+            last->nextReady = head[level];
+        else
+            first = head[level];
+        last = tail[level];
+        head[level] = 0;
+        tail[level] = 0;
+    }
+    bitmap = 0;
+    return first;
+}
+
+/**
+ * Unlinks a task from a level in O(length of the level).
+ *
+ * @param task A pointer to the task.
+ * @param level The level the task was pushed to.
+ * @return True if the task was found.
+ */
+bool RunQueue::Remove(Task *task, int level)
+{
+    if (level < 0)
+        level = 0;
+    if (level >= LEVELS)
+        level = LEVELS - 1;
+
+    Task *previous = 0;
+    for (Task *current = head[level]; current != 0; previous = current, current = current->nextReady)
+    {
+        if (current != task)
+            continue;
+        if (previous != 0)
+            previous->nextReady = task->nextReady;
+        else
+            head[level] = task->nextReady;
+        if (tail[level] == task)
+            tail[level] = previous;
+        if (head[level] == 0)
+            bitmap &= ~(1u << level);
+        task->nextReady = 0;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Moves all tasks of one level behind the tasks of another level in O(1).
+ */
+void RunQueue::Splice(int from, int to)
+{
+    if (from == to || head[from] == 0)
+        return;
+
+    if (tail[to] != 0)
+        tail[to]->nextReady = head[from];
+    else
+        head[to] = head[from];
+    tail[to] = tail[from];
+    head[from] = 0;
+    tail[from] = 0;
+    bitmap = (bitmap & ~(1u << from)) | (1u << to);
+}
+
+/**
+ * @return The highest non-empty level, or -1 if the queue is empty.
+ */
+int RunQueue::Highest()
+{
+    if (bitmap == 0)
+        return -1;
+
+    uint32_t level;
+    asm("bsr %1, %0" : "=r"(level) : "r"(bitmap));
+    return level;
+}
+
+bool RunQueue::IsEmpty()
+{
+    return bitmap == 0;
+}
+
+SchedulerPolicy::SchedulerPolicy()
+{
+    taskManager = 0;
+}
+
+SchedulerPolicy::~SchedulerPolicy()
+{
+}
+
+// Includes the priority inherited from tasks waiting for a mutex the task holds
+int SchedulerPolicy::Priority(Task *task)
+{
+    return task->EffectivePriority();
+}
+
+Task *SchedulerPolicy::NextReady(Task *task)
+{
+    return task->nextReady;
+}
+
+Task *&SchedulerPolicy::Sibling(Task *task)
+{
+    return task->nextReady;
+}
+
+Task *&SchedulerPolicy::Child(Task *task)
+{
+    return task->policyChild;
+}
+
+int &SchedulerPolicy::Level(Task *task)
+{
+    return task->policyLevel;
+}
+
+uint32_t &SchedulerPolicy::Epoch(Task *task)
+{
+    return task->policyEpoch;
+}
+
+uint32_t &SchedulerPolicy::TimeSliceLeft(Task *task)
+{
+    return task->timeSlice;
+}
+
+int SchedulerPolicy::Tickets(Task *task)
+{
+    return task->tickets;
+}
+
+uint32_t &SchedulerPolicy::Pass(Task *task)
+{
+    return task->pass;
+}
+
+void SchedulerPolicy::Enqueue(Task *task)
+{
+}
+
+Task *SchedulerPolicy::Dequeue()
+{
+    return 0;
+}
+
+/**
+ * Charges a clock tick to the time slice of the running task.
+ *
+ * @param running A pointer to the running task, 0 while idle.
+ * @return True if the time slice is used up.
+ */
+bool SchedulerPolicy::Tick(Task *running)
+{
+    if (running == 0)
+        return false;
+    if (running->timeSlice > 1)
+    {
+        running->timeSlice--;
+        return false;
+    }
+    running->timeSlice = 0;
+    return true;
+}
+
+void SchedulerPolicy::Block(Task *task)
+{
+}
+
+uint32_t SchedulerPolicy::TimeSlice(Task *task)
+{
+    return taskManager->GetQuantum(task->priority);
+}
+
+bool SchedulerPolicy::HasReady()
+{
+    return false;
+}
+
+void SchedulerPolicy::UsePriorities(bool enabled)
+{
+}
+
+void SchedulerPolicy::Reprioritize(Task *task)
+{
+}
+
+SchedulerPolicy *SchedulerPolicy::Create()
+{
+    return 0;
+}
+
+RoundRobinPolicy::RoundRobinPolicy()
+{
+}
+
+RoundRobinPolicy::~RoundRobinPolicy()
+{
+}
+
+SchedulerPolicy *RoundRobinPolicy::Create()
+{
+    return new RoundRobinPolicy();
+}
+
+void RoundRobinPolicy::Enqueue(Task *task)
+{
+    queue.Push(task, 0);
+}
+
+Task *RoundRobinPolicy::Dequeue()
+{
+    return queue.Pop();
+}
+
+bool RoundRobinPolicy::HasReady()
+{
+    return !queue.IsEmpty();
+}
+
+PriorityPolicy::PriorityPolicy()
+{
+    enabled = false;
+}
+
+PriorityPolicy::~PriorityPolicy()
+{
+}
+
+SchedulerPolicy *PriorityPolicy::Create()
+{
+    PriorityPolicy *policy = new PriorityPolicy();
+    if (policy != 0)
+        policy->enabled = enabled;
+    return policy;
+}
+
+/**
+ * Returns the run queue level of a task.
+ * While priorities are disabled every task shares level 0, otherwise the priority is used.
+ */
+int PriorityPolicy::QueueLevel(Task *task)
+{
+    if (!enabled || Priority(task) < 0)
+        return 0;
+    return Priority(task) < RunQueue::LEVELS ? Priority(task) : RunQueue::LEVELS - 1;
+}
+
+void PriorityPolicy::Enqueue(Task *task)
+{
+    // the level is kept, it cannot be recomputed once the priority changes
+    Level(task) = QueueLevel(task);
+    queue.Push(task, Level(task));
+}
+
+Task *PriorityPolicy::Dequeue()
+{
+    return queue.Pop();
+}
+
+/**
+ * Preempts the running task when its time slice is used up or a task of higher priority is ready.
+ */
+bool PriorityPolicy::Tick(Task *running)
+{
+    if (running == 0)
+        return false;
+    bool expired = SchedulerPolicy::Tick(running);
+    return expired || queue.Highest() > QueueLevel(running);
+}
+
+bool PriorityPolicy::HasReady()
+{
+    return !queue.IsEmpty();
+}
+
+/**
+ * Enables or disables priorities and re-sorts the READY tasks accordingly.
+ */
+void PriorityPolicy::UsePriorities(bool enabled)
+{
+    if (this->enabled == enabled)
+        return;
+    this->enabled = enabled;
+
+    Task *task = queue.PopAll();
+    while (task != 0)
+    {
+        Task *next = NextReady(task);
+        Enqueue(task);
+        task = next;
+    }
+}
+
+/**
+ * Moves a READY task to the level of its new effective priority.
+ */
+void PriorityPolicy::Reprioritize(Task *task)
+{
+    if (Level(task) != QueueLevel(task) && queue.Remove(task, Level(task)))
+        Enqueue(task);
+}
+
+FeedbackPolicy::FeedbackPolicy()
+{
+    epoch = 1;
+    ticksSinceBoost = 0;
+}
+
+FeedbackPolicy::~FeedbackPolicy()
+{
+}
+
+SchedulerPolicy *FeedbackPolicy::Create()
+{
+    return new FeedbackPolicy();
+}
+
+/**
+ * Moves every task back to the top level.
+ * Queued tasks are spliced over in O(LEVELS), all others are reset lazily by the new epoch.
+ */
+void FeedbackPolicy::Boost()
+{
+    for (int level = LEVELS - 2; level >= 0; level--)
+        queue.Splice(level, LEVELS - 1);
+    epoch++;
+    ticksSinceBoost = 0;
+}
+
+/**
+ * Queues a task at its level. Tasks that are new or have not been seen since the last boost start at the top.
+ */
+void FeedbackPolicy::Enqueue(Task *task)
+{
+    if (Epoch(task) != epoch)
+    {
+        Epoch(task) = epoch;
+        Level(task) = LEVELS - 1;
+    }
+    queue.Push(task, Level(task));
+}
+
+Task *FeedbackPolicy::Dequeue()
+{
+    Task *task = queue.Pop();
+    if (task != 0 && Epoch(task) != epoch)
+    {
+        // queued before the last boost, it was spliced to the top
+        Epoch(task) = epoch;
+        Level(task) = LEVELS - 1;
+    }
+    return task;
+}
+
+/**
+ * Demotes the running task when it uses up its time slice and preempts it
+ * when a task on a higher level is ready. Boosts all tasks once per second.
+ */
+bool FeedbackPolicy::Tick(Task *running)
+{
+    if (++ticksSinceBoost >= taskManager->GetTickRate())
+        Boost();
+
+    if (running == 0)
+        return false;
+
+    if (Epoch(running) != epoch)
+    {
+        // boosted while running, the rest of a long slice from a lower level would outlast the boost
+        Epoch(running) = epoch;
+        Level(running) = LEVELS - 1;
+        if (TimeSliceLeft(running) > TimeSlice(running))
+            TimeSliceLeft(running) = TimeSlice(running);
+    }
+
+    if (SchedulerPolicy::Tick(running))
+    {
+        if (Level(running) > 0)
+            Level(running)--;
+        return true;
+    }
+    return queue.Highest() > Level(running);
+}
+
+/**
+ * Promotes a task that blocks before its time slice is used up.
+ */
+void FeedbackPolicy::Block(Task *task)
+{
+    if (Epoch(task) == epoch && Level(task) < LEVELS - 1)
+        Level(task)++;
+}
+
+/**
+ * The top level gets the quantum of priority 0, each level below twice the slice of the level above,
+ * at most the boost period, so no slice outlasts a boost.
+ */
+uint32_t FeedbackPolicy::TimeSlice(Task *task)
+{
+    int level = Epoch(task) == epoch ? Level(task) : LEVELS - 1;
+    uint32_t slice = taskManager->GetQuantum(0) << (LEVELS - 1 - level);
+    return slice < taskManager->GetTickRate() ? slice : taskManager->GetTickRate();
+}
+
+bool FeedbackPolicy::HasReady()
+{
+    return !queue.IsEmpty();
+}
+
+StridePolicy::StridePolicy()
+{
+    root = 0;
+    count = 0;
+    globalPass = 0;
+}
+
+StridePolicy::~StridePolicy()
+{
+}
+
+SchedulerPolicy *StridePolicy::Create()
+{
+    return new StridePolicy();
+}
+
+// Smaller pass first, compared with wrap-around
+bool StridePolicy::Before(Task *a, Task *b)
+{
+    return (int32_t)(Pass(a) - Pass(b)) < 0;
+}
+
+/**
+ * Joins two heaps, the root with the larger pass becomes the first child of the other.
+ *
+ * @return The root of the joined heap.
+ */
+Task *StridePolicy::Meld(Task *a, Task *b)
+{
+    if (a == 0)
+        return b;
+    if (b == 0)
+        return a;
+    if (Before(b, a))
+    {
+        Task *swap = a;
+        a = b;
+        b = swap;
+    }
+    Sibling(b) = Child(a);
+    Child(a) = b;
+    return a;
+}
+
+/**
+ * Joins the children of a removed root: first in pairs from left to right, then the pairs
+ * from right to left, which keeps the amortized cost of Dequeue at O(log n).
+ *
+ * @param first The first child, the others are linked through Sibling.
+ * @return The root of the joined heap.
+ */
+Task *StridePolicy::MergePairs(Task *first)
+{
+    Task *pairs = 0; // melded pairs, the last one first
+    while (first != 0)
+    {
+        Task *a = first;
+        Task *b = Sibling(a);
+        first = b != 0 ? Sibling(b) : 0;
+        Sibling(a) = 0;
+        if (b != 0)
+            Sibling(b) = 0;
+        Task *pair = Meld(a, b);
+        Sibling(pair) = pairs;
+        pairs = pair;
+    }
+
+    Task *result = 0;
+    while (pairs != 0)
+    {
+        Task *next = Sibling(pairs);
+        Sibling(pairs) = 0;
+        result = Meld(result, pairs);
+        pairs = next;
+    }
+    return result;
+}
+
+/**
+ * Inserts a task into the heap in O(1).
+ * A task that was away (new, blocked or sleeping) joins at the current global pass,
+ * so it cannot claim the CPU time it did not use while it was away.
+ */
+void StridePolicy::Enqueue(Task *task)
+{
+    if ((int32_t)(Pass(task) - globalPass) < 0)
+        Pass(task) = globalPass;
+    Sibling(task) = 0;
+    Child(task) = 0;
+    root = Meld(root, task);
+    count++;
+}
+
+/**
+ * Removes the task with the smallest pass in amortized O(log n).
+ */
+Task *StridePolicy::Dequeue()
+{
+    if (root == 0)
+        return 0;
+
+    Task *task = root;
+    root = MergePairs(Child(task));
+    Child(task) = 0;
+    count--;
+    globalPass = Pass(task);
+    return task;
+}
+
+/**
+ * Advances the pass of the running task by its stride for the tick it used.
+ */
+bool StridePolicy::Tick(Task *running)
+{
+    if (running == 0)
+        return false;
+    Pass(running) += STRIDE / Tickets(running);
+    return SchedulerPolicy::Tick(running);
+}
+
+bool StridePolicy::HasReady()
+{
+    return count > 0;
+}
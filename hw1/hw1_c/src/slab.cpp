@@ -0,0 +1,155 @@
+#include <slab.h>
+#include <memorymanagement.h>
+
+using namespace myos;
+using namespace myos::common;
+
+void printf(char *str);
+void printfHex32(uint32_t key);
+
+SlabCache *myos::SlabCache::caches = 0;
+
+/**
+ * Creates an empty cache. No memory is taken until the first allocation, so caches can be
+ * static objects constructed before the heap exists.
+ *
+ * @param name The name shown in the statistics.
+ * @param objectSize The size of the objects.
+ */
+myos::SlabCache::SlabCache(char *name, size_t objectSize)
+{
+    this->name = name;
+    // room for the free list link, and every object aligned like the heap
+    if (objectSize < sizeof(void *))
+        objectSize = sizeof(void *);
+    this->objectSize = (objectSize + MemoryManager::ALIGNMENT - 1) & ~(MemoryManager::ALIGNMENT - 1);
+    objectsPerSlab = (SLAB_SIZE - MemoryManager::ALIGNMENT) / this->objectSize;
+    if (objectsPerSlab < MIN_OBJECTS)
+        objectsPerSlab = MIN_OBJECTS;
+    freeList = 0;
+    slabs = 0;
+    numSlabs = 0;
+    inUse = 0;
+    peakInUse = 0;
+    allocations = 0;
+    failures = 0;
+
+    nextCache = caches;
+    caches = this;
+}
+
+myos::SlabCache::~SlabCache()
+{
+    for (SlabCache **cache = &caches; *cache != 0; cache = &(*cache)->nextCache)
+        if (*cache == this)
+        {
+            *cache = nextCache;
+            break;
+        }
+
+    if (MemoryManager::activeMemoryManager == 0)
+        return;
+    while (slabs != 0)
+    {
+        void *slab = slabs;
+        slabs = *(void **)slab;
+        MemoryManager::activeMemoryManager->free(slab);
+    }
+}
+
+/**
+ * Takes a new slab from the heap and puts its objects on the free list. The lock must be held.
+ *
+ * @return False if the heap is exhausted.
+ */
+bool myos::SlabCache::Grow()
+{
+    if (MemoryManager::activeMemoryManager == 0)
+        return false;
+    // the first ALIGNMENT bytes link the slab into the list of slabs
+    uint8_t *slab = (uint8_t *)MemoryManager::activeMemoryManager->malloc(MemoryManager::ALIGNMENT + objectsPerSlab * objectSize);
+    if (slab == 0)
+        return false;
+
+    *(void **)slab = slabs;
+    slabs = slab;
+    numSlabs++;
+
+    uint8_t *object = slab + MemoryManager::ALIGNMENT;
+    for (int i = 0; i < objectsPerSlab; i++, object += objectSize)
+    {
+        *(void **)object = freeList;
+        freeList = object;
+    }
+    return true;
+}
+
+/**
+ * @return An uninitialized object, or 0 if the heap is exhausted.
+ */
+void *myos::SlabCache::Allocate()
+{
+    SpinlockGuard guard(&lock);
+    if (freeList == 0 && !Grow())
+    {
+        failures++;
+        return 0;
+    }
+
+    void *object = freeList;
+    freeList = *(void **)object;
+    allocations++;
+    if (++inUse > peakInUse)
+        peakInUse = inUse;
+    return object;
+}
+
+/**
+ * Returns an object to the cache.
+ *
+ * @param object An object allocated from this cache, or 0.
+ */
+void myos::SlabCache::Free(void *object)
+{
+    if (object == 0)
+        return;
+    SpinlockGuard guard(&lock);
+    *(void **)object = freeList;
+    freeList = object;
+    inUse--;
+}
+
+size_t myos::SlabCache::ObjectSize()
+{
+    return objectSize;
+}
+
+/**
+ * Prints one line per cache: object size, slabs, objects in use, the peak of objects in use,
+ * allocations and failed allocations.
+ */
+void myos::SlabCache::PrintStatistics()
+{
+    printf("CACHE            SIZE     SLABS    IN USE   PEAK     ALLOCS   FAILED\n");
+    for (SlabCache *cache = caches; cache != 0; cache = cache->nextCache)
+    {
+        printf(cache->name);
+        int length = 0;
+        while (cache->name[length] != '\0')
+            length++;
+        for (; length < 17; length++)
+            printf(" ");
+        printfHex32(cache->objectSize);
+        printf(" ");
+        printfHex32(cache->numSlabs);
+        printf(" ");
+        printfHex32(cache->inUse);
+        printf(" ");
+        printfHex32(cache->peakInUse);
+        printf(" ");
+        printfHex32(cache->allocations);
+        printf(" ");
+        printfHex32(cache->failures);
+        printf("\n");
+    }
+}
@@ -0,0 +1,247 @@
+#include <smp.h>
+#include <hardwarecommunication/apic.h>
+#include <drivers/pit.h>
+
+using namespace myos;
+using namespace myos::common;
+using namespace myos::drivers;
+using namespace myos::hardwarecommunication;
+
+struct MultiProcessorFloatingPointer
+{
+    char signature[4]; // "_MP_"
+    uint32_t configuration;
+    uint8_t length; // in 16 byte units
+    uint8_t revision;
+    uint8_t checksum;
+    uint8_t features[5];
+} __attribute__((packed));
+
+struct MultiProcessorConfiguration
+{
+    char signature[4]; // "PCMP"
+    uint16_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem[8];
+    char product[12];
+    uint32_t oemTable;
+    uint16_t oemTableSize;
+    uint16_t entryCount;
+    uint32_t localApic;
+    uint16_t extendedLength;
+    uint8_t extendedChecksum;
+    uint8_t reserved;
+} __attribute__((packed));
+
+struct MultiProcessorProcessorEntry
+{
+    uint8_t type; // 0
+    uint8_t apicId;
+    uint8_t apicVersion;
+    uint8_t flags; // bit 0: usable, bit 1: boot processor
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} __attribute__((packed));
+
+struct MultiProcessorIOAPICEntry
+{
+    uint8_t type; // 2
+    uint8_t apicId;
+    uint8_t apicVersion;
+    uint8_t flags; // bit 0: usable
+    uint32_t address;
+} __attribute__((packed));
+
+extern "C" uint8_t smp_trampoline_start[];
+extern "C" uint8_t smp_trampoline_end[];
+extern "C" uint8_t smp_trampoline_stack[];
+extern "C" uint8_t smp_trampoline_entry[];
+
+volatile int MultiProcessor::numStarted = 0;
+
+static bool checksum(uint8_t *data, uint32_t length)
+{
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++)
+        sum += data[i];
+    return sum == 0;
+}
+
+MultiProcessor::MultiProcessor()
+{
+    numProcessors = 1;
+    bootApicId = 0;
+    apicIds[0] = 0;
+    localApicAddress = LocalAPIC::DEFAULT_BASE;
+    ioApicAddress = 0;
+}
+
+MultiProcessor::~MultiProcessor()
+{
+}
+
+void *MultiProcessor::FindFloatingPointer(uint32_t start, uint32_t length)
+{
+    for (uint32_t address = start; address + 16 <= start + length; address += 16)
+    {
+        MultiProcessorFloatingPointer *pointer = (MultiProcessorFloatingPointer *)address;
+        if (pointer->signature[0] == '_' && pointer->signature[1] == 'M' &&
+            pointer->signature[2] == 'P' && pointer->signature[3] == '_' &&
+            checksum((uint8_t *)pointer, pointer->length * 16))
+            return pointer;
+    }
+    return 0;
+}
+
+bool MultiProcessor::ParseConfiguration(uint32_t address)
+{
+    MultiProcessorConfiguration *configuration = (MultiProcessorConfiguration *)address;
+    if (configuration->signature[0] != 'P' || configuration->signature[1] != 'C' ||
+        configuration->signature[2] != 'M' || configuration->signature[3] != 'P' ||
+        !checksum((uint8_t *)configuration, configuration->length))
+        return false;
+
+    localApicAddress = configuration->localApic;
+    numProcessors = 0;
+
+    uint8_t *entry = (uint8_t *)(configuration + 1);
+    for (int i = 0; i < configuration->entryCount; i++)
+    {
+        if (entry[0] == 0)
+        {
+            MultiProcessorProcessorEntry *processor = (MultiProcessorProcessorEntry *)entry;
+            if ((processor->flags & 0x01) && numProcessors < MAX_PROCESSORS)
+            {
+                if (processor->flags & 0x02)
+                    bootApicId = processor->apicId;
+                apicIds[numProcessors++] = processor->apicId;
+            }
+            entry += sizeof(MultiProcessorProcessorEntry);
+        }
+        else
+        {
+            if (entry[0] == 2 && ioApicAddress == 0)
+            {
+                MultiProcessorIOAPICEntry *ioApic = (MultiProcessorIOAPICEntry *)entry;
+                if (ioApic->flags & 0x01)
+                    ioApicAddress = ioApic->address;
+            }
+            entry += 8; // buses, I/O APICs and interrupt assignments
+        }
+    }
+
+    if (numProcessors == 0)
+    {
+        numProcessors = 1;
+        apicIds[0] = bootApicId;
+    }
+    return true;
+}
+
+/**
+ * Looks for the MP floating pointer in the first KiB of the EBDA, the last KiB of base memory
+ * and the BIOS ROM, and reads the processors and the first I/O APIC from its configuration table.
+ * Systems without the table are treated as uniprocessor.
+ *
+ * @return True if the table was found.
+ */
+bool MultiProcessor::Detect()
+{
+    uint32_t ebda = (uint32_t)(*(uint16_t *)0x40E) << 4;
+    MultiProcessorFloatingPointer *pointer = 0;
+    if (ebda != 0)
+        pointer = (MultiProcessorFloatingPointer *)FindFloatingPointer(ebda, 1024);
+    if (pointer == 0)
+        pointer = (MultiProcessorFloatingPointer *)FindFloatingPointer(0x9FC00, 1024);
+    if (pointer == 0)
+        pointer = (MultiProcessorFloatingPointer *)FindFloatingPointer(0xF0000, 0x10000);
+
+    // without a configuration table (default configurations) there is a single processor to use
+    if (pointer == 0 || pointer->configuration == 0)
+        return false;
+    return ParseConfiguration(pointer->configuration);
+}
+
+int MultiProcessor::GetNumProcessors()
+{
+    return numProcessors;
+}
+
+uint8_t MultiProcessor::GetAPICID(int processor)
+{
+    return apicIds[processor];
+}
+
+uint8_t MultiProcessor::GetBootAPICID()
+{
+    return bootApicId;
+}
+
+uint32_t MultiProcessor::GetLocalAPICAddress()
+{
+    return localApicAddress;
+}
+
+uint32_t MultiProcessor::GetIOAPICAddress()
+{
+    return ioApicAddress;
+}
+
+/**
+ * Starts the application processors one after the other with INIT-SIPI-SIPI.
+ * Each one runs the entry point on a fresh stack and must call ProcessorStarted
+ * once it no longer needs the trampoline, before the next processor is started.
+ * The local APIC of the boot processor must be enabled.
+ *
+ * @param entrypoint The function the application processors run, it must not return.
+ * @return The number of application processors that came up.
+ */
+int MultiProcessor::StartApplicationProcessors(void entrypoint())
+{
+    uint8_t *trampoline = (uint8_t *)TRAMPOLINE;
+    uint32_t size = smp_trampoline_end - smp_trampoline_start;
+    for (uint32_t i = 0; i < size; i++)
+        trampoline[i] = smp_trampoline_start[i];
+
+    uint32_t *stack = (uint32_t *)(trampoline + (smp_trampoline_stack - smp_trampoline_start));
+    uint32_t *entry = (uint32_t *)(trampoline + (smp_trampoline_entry - smp_trampoline_start));
+    *entry = (uint32_t)entrypoint;
+
+    int started = 0;
+    for (int i = 0; i < numProcessors; i++)
+    {
+        if (apicIds[i] == bootApicId)
+            continue;
+
+        uint8_t *memory = new uint8_t[STACK_SIZE];
+        if (memory == 0)
+            break;
+        *stack = (uint32_t)(memory + STACK_SIZE);
+
+        int before = numStarted;
+        LocalAPIC::SendInit(apicIds[i]);
+        ProgrammableIntervalTimer::Delay(10000);
+        for (int attempt = 0; attempt < 2 && numStarted == before; attempt++)
+        {
+            LocalAPIC::SendStartup(apicIds[i], TRAMPOLINE >> 12);
+            for (int wait = 0; wait < 100 && numStarted == before; wait++)
+                ProgrammableIntervalTimer::Delay(1000);
+        }
+
+        if (numStarted == before)
+            delete[] memory; // the processor did not come up, it never touched the stack
+        else
+            started++;
+    }
+    return started;
+}
+
+/**
+ * Tells the boot processor that the calling application processor is up and off the trampoline.
+ */
+void MultiProcessor::ProcessorStarted()
+{
+    asm volatile("lock incl %0" : "+m"(numStarted) : : "memory");
+}
@@ -0,0 +1,59 @@
+# Startup code of the application processors. It is copied to MultiProcessor::TRAMPOLINE,
+# where a startup IPI lets the processor begin in real mode. It switches to protected mode
+# with flat segments at the selectors the kernel GDT uses and calls smp_trampoline_entry
+# on the stack in smp_trampoline_stack. Both are filled in by the boot processor.
+
+.set TRAMPOLINE, 0x8000
+
+.section .text
+.code16
+.global smp_trampoline_start
+smp_trampoline_start:
+    cli
+    cld
+    xorw %ax, %ax
+    movw %ax, %ds
+    lgdtl smp_gdt_pointer - smp_trampoline_start + TRAMPOLINE
+    movl %cr0, %eax
+    orl $1, %eax
+    movl %eax, %cr0
+    ljmpl $0x10, $(smp_protected_mode - smp_trampoline_start + TRAMPOLINE)
+
+.code32
+smp_protected_mode:
+    movw $0x18, %ax
+    movw %ax, %ds
+    movw %ax, %es
+    movw %ax, %fs
+    movw %ax, %gs
+    movw %ax, %ss
+    movl smp_trampoline_stack - smp_trampoline_start + TRAMPOLINE, %esp
+    movl smp_trampoline_entry - smp_trampoline_start + TRAMPOLINE, %eax
+    call *%eax
+
+smp_stop:
+    cli
+    hlt
+    jmp smp_stop
+
+.align 8
+smp_gdt:
+    .quad 0
+    .quad 0
+    .quad 0x00CF9A000000FFFF # 0x10: code, flat 4 GiB
+    .quad 0x00CF92000000FFFF # 0x18: data, flat 4 GiB
+smp_gdt_pointer:
+    .word smp_gdt_pointer - smp_gdt - 1
+    .long smp_gdt - smp_trampoline_start + TRAMPOLINE
+
+.global smp_trampoline_stack
+smp_trampoline_stack:
+    .long 0
+.global smp_trampoline_entry
+smp_trampoline_entry:
+    .long 0
+
+.global smp_trampoline_end
+smp_trampoline_end:
+
+.section .note.GNU-stack,"",@progbits
@@ -0,0 +1,80 @@
+#include <spinlock.h>
+
+using namespace myos;
+using namespace myos::common;
+
+Spinlock::Spinlock()
+{
+    locked = 0;
+}
+
+Spinlock::~Spinlock()
+{
+}
+
+/**
+ * Takes the lock, spinning until it is free.
+ */
+void Spinlock::Acquire()
+{
+    while (!TryAcquire())
+    {
+        // wait on a plain read, so the cache line is not bounced while the lock is held
+        while (locked != 0)
+            asm volatile("pause");
+    }
+}
+
+/**
+ * Takes the lock if it is free.
+ *
+ * @return True if the lock was taken.
+ */
+bool Spinlock::TryAcquire()
+{
+    uint32_t previous = 1;
+    asm volatile("xchgl %0, %1" : "+r"(previous), "+m"(locked) : : "memory");
+    return previous == 0;
+}
+
+void Spinlock::Release()
+{
+    asm volatile("" : : : "memory");
+    locked = 0;
+}
+
+/**
+ * Disables interrupts on this processor, then takes the lock.
+ *
+ * @return The previous EFLAGS, to be passed to ReleaseIrqRestore.
+ */
+uint32_t Spinlock::AcquireIrqSave()
+{
+    uint32_t flags;
+    asm volatile("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    Acquire();
+    return flags;
+}
+
+/**
+ * Releases the lock and enables interrupts again if they were enabled before AcquireIrqSave.
+ *
+ * @param flags The EFLAGS returned by AcquireIrqSave.
+ */
+void Spinlock::ReleaseIrqRestore(uint32_t flags)
+{
+    Release();
+    if (flags & 0x200)
+        asm volatile("sti" : : : "memory");
+}
+
+SpinlockGuard::SpinlockGuard(Spinlock *lock)
+{
+    this->lock = lock;
+    flags = lock->AcquireIrqSave();
+}
+
+SpinlockGuard::~SpinlockGuard()
+{
+    lock->ReleaseIrqRestore(flags);
+}
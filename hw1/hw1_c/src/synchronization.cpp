@@ -0,0 +1,229 @@
+#include <synchronization.h>
+
+using namespace myos;
+using namespace myos::common;
+
+/**
+ * @return True if interrupts are enabled, i.e. the caller is a task and not an interrupt handler
+ * or code holding a spinlock, so it may sleep.
+ */
+static bool CanSleep()
+{
+    uint32_t flags;
+    asm volatile("pushfl; popl %0" : "=r"(flags));
+    return (flags & 0x200) != 0;
+}
+
+/**
+ * Puts the calling task to sleep as long as a word holds a value.
+ *
+ * @param address The address of the word.
+ * @param value The value the caller has seen in the word.
+ * @param timeoutMs The longest time to sleep in milliseconds, 0 to wait for a Wake only.
+ * @return 0 when woken by Wake, AGAIN if the word changed before the task went to sleep,
+ * or TIMED_OUT if the timeout passed or the caller cannot sleep.
+ */
+int Futex::Wait(volatile uint32_t *address, uint32_t value, uint32_t timeoutMs)
+{
+    if (!CanSleep())
+        return TIMED_OUT;
+    int result;
+    asm volatile("int $0x80" : "=a"(result) : "a"(240), "b"(address), "c"(WAIT), "d"(value), "S"(timeoutMs) : "memory");
+    return result;
+}
+
+/**
+ * Wakes tasks sleeping on a word. Does not switch tasks, so it may be called from interrupt handlers.
+ *
+ * @param address The address of the word.
+ * @param n The most tasks to wake, highest priority first, or ALL.
+ * @return The number of tasks woken.
+ */
+int Futex::Wake(volatile uint32_t *address, int n)
+{
+    if (TaskManager::activeTaskManager == 0)
+        return 0;
+    return TaskManager::activeTaskManager->FutexWake(address, n);
+}
+
+Mutex::Mutex()
+{
+    owner = 0;
+    nextHeld = 0;
+}
+
+Mutex::~Mutex()
+{
+}
+
+/**
+ * Takes the mutex, sleeping until its owner unlocks it.
+ */
+void Mutex::Lock()
+{
+    asm volatile("int $0x80" : : "a"(240), "b"(this), "c"(Futex::LOCK_PI) : "memory");
+}
+
+/**
+ * Takes the mutex if no task owns it.
+ *
+ * @return True if the mutex was taken.
+ */
+bool Mutex::TryLock()
+{
+    int result;
+    asm volatile("int $0x80" : "=a"(result) : "a"(240), "b"(this), "c"(Futex::TRYLOCK_PI) : "memory");
+    return result == 0;
+}
+
+/**
+ * Hands the mutex to the highest priority waiter, or leaves it free.
+ * The caller loses the priority it inherited through the mutex and gives up the CPU
+ * if the new owner has a higher priority.
+ */
+void Mutex::Unlock()
+{
+    asm volatile("int $0x80" : : "a"(240), "b"(this), "c"(Futex::UNLOCK_PI) : "memory");
+}
+
+bool Mutex::IsLocked()
+{
+    return owner != 0;
+}
+
+Semaphore::Semaphore(uint32_t count)
+{
+    this->count = count;
+    sleepers = 0;
+}
+
+Semaphore::~Semaphore()
+{
+}
+
+/**
+ * Takes a unit if one is available, without sleeping.
+ *
+ * @return True if a unit was taken.
+ */
+bool Semaphore::TryWait()
+{
+    uint32_t available = count;
+    while (available > 0)
+    {
+        uint32_t seen = __sync_val_compare_and_swap(&count, available, available - 1);
+        if (seen == available)
+            return true;
+        available = seen;
+    }
+    return false;
+}
+
+/**
+ * Takes a unit, sleeping until one is posted.
+ */
+void Semaphore::Wait()
+{
+    if (TryWait())
+        return;
+    __sync_fetch_and_add(&sleepers, 1);
+    while (!TryWait())
+        Futex::Wait(&count, 0);
+    __sync_fetch_and_sub(&sleepers, 1);
+}
+
+/**
+ * Takes a unit, sleeping until one is posted or the timeout passes. A task that is woken
+ * but loses the unit to another one sleeps again only for the rest of the timeout.
+ *
+ * @param timeoutMs The longest time to sleep in milliseconds, 0 to sleep until a unit is posted.
+ * @return True if a unit was taken.
+ */
+bool Semaphore::Wait(uint32_t timeoutMs)
+{
+    if (TryWait())
+        return true;
+    if (timeoutMs == 0 || TaskManager::activeTaskManager == 0)
+    {
+        Wait();
+        return true;
+    }
+
+    // the deadline in clock ticks, rounded up as the futex rounds its timeout
+    TaskManager *taskManager = TaskManager::activeTaskManager;
+    uint32_t tickRate = taskManager->GetTickRate();
+    uint32_t deadline = taskManager->GetClockCounter() + (timeoutMs / 1000) * tickRate + ((timeoutMs % 1000) * tickRate + 999) / 1000;
+
+    __sync_fetch_and_add(&sleepers, 1);
+    bool taken;
+    uint32_t remainingMs = timeoutMs;
+    while (!(taken = TryWait()))
+    {
+        if (remainingMs == 0 || Futex::Wait(&count, 0, remainingMs) == Futex::TIMED_OUT)
+        {
+            taken = TryWait();
+            break;
+        }
+        int32_t left = deadline - taskManager->GetClockCounter();
+        remainingMs = left <= 0 ? 0 : (left / tickRate) * 1000 + ((left % tickRate) * 1000 + tickRate - 1) / tickRate;
+    }
+    __sync_fetch_and_sub(&sleepers, 1);
+    return taken;
+}
+
+/**
+ * Adds a unit and wakes one sleeping task. The sleepers count is read after the unit is added,
+ * so either the sleeper sees the unit or the poster sees the sleeper.
+ */
+void Semaphore::Post()
+{
+    __sync_fetch_and_add(&count, 1);
+    if (sleepers > 0)
+        Futex::Wake(&count, 1);
+}
+
+uint32_t Semaphore::GetCount()
+{
+    return count;
+}
+
+ConditionVariable::ConditionVariable()
+{
+    sequence = 0;
+}
+
+ConditionVariable::~ConditionVariable()
+{
+}
+
+/**
+ * Unlocks the mutex, sleeps until the condition variable is signalled and locks the mutex again.
+ * A signal after the unlock and before the sleep changes the sequence, so it is not lost.
+ *
+ * @param mutex A pointer to the mutex held by the caller.
+ */
+void ConditionVariable::Wait(Mutex *mutex)
+{
+    uint32_t seen = sequence;
+    mutex->Unlock();
+    Futex::Wait(&sequence, seen);
+    mutex->Lock();
+}
+
+/**
+ * Wakes the highest priority waiting task.
+ */
+void ConditionVariable::Signal()
+{
+    __sync_fetch_and_add(&sequence, 1);
+    Futex::Wake(&sequence, 1);
+}
+
+/**
+ * Wakes all waiting tasks.
+ */
+void ConditionVariable::Broadcast()
+{
+    __sync_fetch_and_add(&sequence, 1);
+    Futex::Wake(&sequence, Futex::ALL);
+}
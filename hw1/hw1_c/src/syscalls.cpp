@@ -1,47 +1,177 @@
-
 #include <syscalls.h>
+#include <synchronization.h>
+#include <drivers/console.h>
+#include <drivers/terminal.h>
 
 using namespace myos;
 using namespace myos::common;
 using namespace myos::hardwarecommunication;
 
-SyscallHandler::SyscallHandler(InterruptManager *interruptManager, uint8_t InterruptNumber)
+void printf(char *);
+
+static CPUState *sys_exit(TaskManager *taskManager, CPUState *cpu)
+{
+    if (drivers::Console::activeConsole != 0)
+        drivers::Console::activeConsole->Flush();
+    return taskManager->Exit(cpu);
+}
+
+static CPUState *sys_fork(TaskManager *taskManager, CPUState *cpu)
+{
+    cpu->eax = (uint32_t)taskManager->fork((uint32_t)cpu);
+    return cpu;
+}
+
+// ebx the file descriptor, only 0 (the console), ecx the buffer, edx its size
+static CPUState *sys_read(TaskManager *taskManager, CPUState *cpu)
+{
+    if (cpu->ebx != 0 || drivers::Terminal::activeTerminal == 0)
+    {
+        cpu->eax = (uint32_t)-1;
+        return cpu;
+    }
+    // the prompt the task printed is still in its line buffer
+    if (drivers::Console::activeConsole != 0)
+        drivers::Console::activeConsole->Flush();
+
+    Task *task = taskManager->GetCurrentTask();
+    int count = task != 0 ? task->ReadInput((char *)cpu->ecx, (int)cpu->edx) : -1;
+    if (count >= 0)
+    {
+        cpu->eax = count;
+        return cpu;
+    }
+    return drivers::Terminal::activeTerminal->Read(taskManager, cpu);
+}
+
+static CPUState *sys_print(TaskManager *taskManager, CPUState *cpu)
+{
+    // behind what the task already printed with interrupts on
+    if (drivers::Console::activeConsole != 0)
+        drivers::Console::activeConsole->Flush();
+    printf((char *)cpu->ebx);
+    return cpu;
+}
+
+// ebx the tickets of the calling task under stride scheduling, like nice
+static CPUState *sys_settickets(TaskManager *taskManager, CPUState *cpu)
+{
+    taskManager->SetTickets((int)cpu->ebx);
+    cpu->eax = 0;
+    return cpu;
+}
+
+static CPUState *sys_waitpid(TaskManager *taskManager, CPUState *cpu)
+{
+    int pid = cpu->ebx;
+    return taskManager->WaitPids(cpu, &pid, 1, false);
+}
+
+static CPUState *sys_waitpids(TaskManager *taskManager, CPUState *cpu)
+{
+    return taskManager->WaitPids(cpu, (int *)cpu->ebx, cpu->ecx, cpu->edx != 0);
+}
+
+static CPUState *sys_taskstats(TaskManager *taskManager, CPUState *cpu)
+{
+    cpu->eax = (uint32_t)taskManager->GetStatistics((int)cpu->ebx, (TaskStatistics *)cpu->ecx);
+    return cpu;
+}
+
+static CPUState *sys_yield(TaskManager *taskManager, CPUState *cpu)
+{
+    cpu->eax = 0;
+    return taskManager->Yield(cpu);
+}
+
+static CPUState *sys_sleep(TaskManager *taskManager, CPUState *cpu)
+{
+    return taskManager->Sleep(cpu, cpu->ebx);
+}
+
+static CPUState *sys_setdeadline(TaskManager *taskManager, CPUState *cpu)
+{
+    cpu->eax = (uint32_t)taskManager->SetDeadline(cpu->ebx, cpu->ecx);
+    return cpu;
+}
+
+// ebx is the futex word, or the Mutex for the PI operations, ecx the operation (Futex::WAIT...),
+// edx the expected value for WAIT or the number of tasks for WAKE, esi the timeout of WAIT in milliseconds
+static CPUState *sys_futex(TaskManager *taskManager, CPUState *cpu)
+{
+    switch (cpu->ecx)
+    {
+    case Futex::WAIT:
+        return taskManager->FutexWait(cpu, (volatile uint32_t *)cpu->ebx, cpu->edx, cpu->esi);
+    case Futex::WAKE:
+        cpu->eax = (uint32_t)taskManager->FutexWake((volatile uint32_t *)cpu->ebx, (int)cpu->edx);
+        return cpu;
+    case Futex::LOCK_PI:
+        return taskManager->LockMutex(cpu, (Mutex *)cpu->ebx);
+    case Futex::UNLOCK_PI:
+        return taskManager->UnlockMutex(cpu, (Mutex *)cpu->ebx);
+    case Futex::TRYLOCK_PI:
+        cpu->eax = (uint32_t)taskManager->TryLockMutex((Mutex *)cpu->ebx);
+        return cpu;
+    }
+    cpu->eax = (uint32_t)-1;
+    return cpu;
+}
+
+SyscallHandler::SyscallHandler(InterruptManager *interruptManager, uint8_t InterruptNumber, TaskManager *taskManager)
     : InterruptHandler(interruptManager, InterruptNumber + interruptManager->HardwareInterruptOffset())
 {
+    this->taskManager = taskManager;
+    for (int i = 0; i < NUM_SYSCALLS; i++)
+        syscalls[i] = 0;
+
+    Register(1, sys_exit);
+    Register(2, sys_fork);
+    Register(3, sys_read);
+    Register(4, sys_print);
+    Register(7, sys_waitpid);
+    Register(34, sys_settickets);
+    Register(8, sys_waitpids);
+    Register(116, sys_taskstats);
+    Register(158, sys_yield);
+    Register(162, sys_sleep);
+    Register(240, sys_futex);
+    Register(351, sys_setdeadline);
 }
 
 SyscallHandler::~SyscallHandler()
 {
 }
 
-void printf(char *);
-void printfHex32(uint32_t);
-int __fork(uint32_t);
+/**
+ * Adds a syscall to the dispatch table, replacing the one with the same number.
+ *
+ * @param number The syscall number, passed in eax.
+ * @param syscall The function handling the syscall.
+ */
+void SyscallHandler::Register(uint32_t number, Syscall syscall)
+{
+    if (number < NUM_SYSCALLS)
+        syscalls[number] = syscall;
+}
 
 /**
  * Handles the interrupt for system calls.
  *
- * This function takes the CPU state as input and handles the system call interrupt
- * based on the value of the EAX register in the CPU state.
+ * The value of the EAX register in the CPU state selects the syscall from the dispatch table.
+ * Unknown syscalls return -1 in EAX.
  *
  * @param esp The stack pointer value (ESP) representing the CPU state.
- * @return The updated stack pointer value after handling the interrupt.
+ * @return The stack pointer of the CPU state to resume, another task's if the syscall switched tasks.
  */
 uint32_t SyscallHandler::HandleInterrupt(uint32_t esp)
 {
     CPUState *cpu = (CPUState *)esp;
 
-    switch (cpu->eax)
+    if (cpu->eax >= NUM_SYSCALLS || syscalls[cpu->eax] == 0)
     {
-    case 2:
-        cpu->eax = (uint32_t)__fork(esp);
-        break;
-    case 4:
-        printf((char *)cpu->ebx);
-        break;
-    default:
-        break;
+        cpu->eax = (uint32_t)-1;
+        return esp;
     }
-
-    return esp;
+    return (uint32_t)syscalls[cpu->eax](taskManager, cpu);
 }
@@ -0,0 +1,149 @@
+#include <timerwheel.h>
+
+using namespace myos;
+using namespace myos::common;
+
+myos::TimerWheel::TimerWheel()
+{
+    now = 0;
+    count = 0;
+    for (int level = 0; level < LEVELS; level++)
+        for (int i = 0; i < SLOTS; i++)
+            slots[level][i] = 0;
+}
+
+myos::TimerWheel::~TimerWheel()
+{
+}
+
+/**
+ * Puts a timer into the slot matching its distance from now.
+ * Timers in the past expire on the next tick, timers too far away are clamped to MAX_DELAY.
+ */
+void myos::TimerWheel::Link(TimerEntry *entry)
+{
+    uint32_t delta = entry->expires - now;
+    if ((int32_t)delta < 0)
+    {
+        delta = 0;
+        entry->expires = now;
+    }
+    if (delta > MAX_DELAY)
+    {
+        delta = MAX_DELAY;
+        entry->expires = now + MAX_DELAY;
+    }
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1u << ((level + 1) * SLOT_BITS)))
+        level++;
+    int index = (entry->expires >> (level * SLOT_BITS)) & (SLOTS - 1);
+
+    entry->prev = 0;
+    entry->next = slots[level][index];
+    if (entry->next != 0)
+        entry->next->prev = entry;
+    slots[level][index] = entry;
+}
+
+/**
+ * Moves all timers of a higher level slot down to the levels below.
+ */
+void myos::TimerWheel::Cascade(int level, int index)
+{
+    TimerEntry *entry = slots[level][index];
+    slots[level][index] = 0;
+    while (entry != 0)
+    {
+        TimerEntry *next = entry->next;
+        Link(entry);
+        entry = next;
+    }
+}
+
+/**
+ * Schedules a timer. A timer that is already pending is moved to the new time.
+ *
+ * @param entry A pointer to the timer, owned by the caller.
+ * @param expires The clock tick at which the timer expires.
+ */
+void myos::TimerWheel::Add(TimerEntry *entry, uint32_t expires)
+{
+    if (entry->pending)
+        Cancel(entry);
+    entry->expires = expires;
+    entry->pending = true;
+    Link(entry);
+    count++;
+}
+
+/**
+ * Removes a pending timer from the wheel.
+ *
+ * @param entry A pointer to the timer.
+ */
+void myos::TimerWheel::Cancel(TimerEntry *entry)
+{
+    if (!entry->pending)
+        return;
+
+    if (entry->prev != 0)
+    {
+        entry->prev->next = entry->next;
+    }
+    else
+    {
+        // the head of a slot, find the slot it is the head of
+        for (int level = 0; level < LEVELS; level++)
+        {
+            int index = (entry->expires >> (level * SLOT_BITS)) & (SLOTS - 1);
+            if (slots[level][index] == entry)
+            {
+                slots[level][index] = entry->next;
+                break;
+            }
+        }
+    }
+    if (entry->next != 0)
+        entry->next->prev = entry->prev;
+
+    entry->pending = false;
+    count--;
+}
+
+/**
+ * Processes one clock tick.
+ *
+ * @return The timers that expired on this tick, linked through their next pointers.
+ */
+TimerEntry *myos::TimerWheel::Tick()
+{
+    int index = now & (SLOTS - 1);
+    for (int level = 1; level < LEVELS && index == 0; level++)
+    {
+        index = (now >> (level * SLOT_BITS)) & (SLOTS - 1);
+        Cascade(level, index);
+    }
+
+    index = now & (SLOTS - 1);
+    TimerEntry *expired = slots[0][index];
+    slots[0][index] = 0;
+    for (TimerEntry *entry = expired; entry != 0; entry = entry->next)
+    {
+        entry->pending = false;
+        count--;
+    }
+
+    now++;
+    return expired;
+}
+
+uint32_t myos::TimerWheel::Now()
+{
+    return now;
+}
+
+bool myos::TimerWheel::IsEmpty()
+{
+    return count == 0;
+}